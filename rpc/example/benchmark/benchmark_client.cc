@@ -168,9 +168,50 @@ void throughput_test(lcz_rpc::client::RpcClient& client,
     std::cout << "在 " << duration_seconds << " 秒内完成了 " << count << " 个请求" << std::endl;
 }
 
+// 对冲测试：同一负载先不开对冲跑一遍，再开启对冲跑一遍，对比尾延迟
+void hedge_test(lcz_rpc::client::RpcClient& client,
+                const std::string& method,
+                const Json::Value& params,
+                int requests,
+                int hedge_delay_ms,
+                BenchmarkStats& baseline,
+                BenchmarkStats& hedged) {
+    std::cout << "[1/2] 未开启对冲" << std::endl;
+    single_thread_test(client, method, params, requests, baseline);
+
+    lcz_rpc::client::HedgePolicy policy;
+    policy.delay_ms = hedge_delay_ms;  // 0 表示使用自适应 p95
+    policy.budget_ratio = 0.1;
+    client.setHedgePolicy(method, policy);
+    std::cout << "[2/2] 开启对冲，延迟: "
+              << (hedge_delay_ms > 0 ? std::to_string(hedge_delay_ms) + " ms" : std::string("自适应 p95")) << std::endl;
+    single_thread_test(client, method, params, requests, hedged);
+
+    auto st = client.hedgeStats(method);
+    std::cout << "对冲请求: " << st.hedges << " / " << st.requests
+              << "，对冲胜出: " << st.hedge_wins << std::endl;
+}
+
+// 负载均衡对比：同一负载分别用 ROUND_ROBIN 和 P2C_LATENCY 跑一遍（多线程，让在途数起作用）
+void lb_test(lcz_rpc::client::RpcClient& client,
+             const std::string& method,
+             const Json::Value& params,
+             int requests,
+             int thread_count,
+             BenchmarkStats& round_robin,
+             BenchmarkStats& p2c) {
+    std::cout << "[1/2] ROUND_ROBIN" << std::endl;
+    client.setloadbalanceStrategy(lcz_rpc::LoadBalanceStrategy::ROUND_ROBIN);
+    multi_thread_test(client, method, params, requests, thread_count, round_robin);
+
+    std::cout << "[2/2] P2C_LATENCY" << std::endl;
+    client.setloadbalanceStrategy(lcz_rpc::LoadBalanceStrategy::P2C_LATENCY);
+    multi_thread_test(client, method, params, requests, thread_count, p2c);
+}
+
 int main(int argc, char* argv[])
 {
-    std::string test_type = "single";  // single, multi, throughput
+    std::string test_type = "single";  // single, multi, throughput, hedge, lb
     std::string method = "add";
     int requests = 10000;
     int threads = 4;
@@ -179,6 +220,7 @@ int main(int argc, char* argv[])
     std::string server_ip = "127.0.0.1";
     int server_port = 8889;
     int registry_port = 8080;
+    int hedge_delay_ms = 0;  // hedge 模式的对冲延迟，0 表示自适应
     
     // 解析命令行参数
     if (argc > 1) test_type = argv[1];
@@ -190,6 +232,7 @@ int main(int argc, char* argv[])
     if (argc > 7) server_ip = argv[7];
     if (argc > 8) server_port = std::atoi(argv[8]);
     if (argc > 9) registry_port = std::atoi(argv[9]);
+    if (argc > 10) hedge_delay_ms = std::atoi(argv[10]);
     
     std::cout << "========== RPC 性能测试 ==========" << std::endl;
     std::cout << "测试类型: " << test_type << std::endl;
@@ -200,8 +243,8 @@ int main(int argc, char* argv[])
     // 创建客户端
     lcz_rpc::client::RpcClient client(use_discover, server_ip, use_discover ? registry_port : server_port);
     
-    // 等待连接建立
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    // 预热：提前完成服务发现和建连，避免首批请求的冷启动开销计入测试结果
+    client.warmup({"add", method}, true);
     
     // 测试连接（通过一次简单的调用）
     Json::Value test_params;
@@ -238,9 +281,31 @@ int main(int argc, char* argv[])
     } else if (test_type == "throughput") {
         std::cout << "吞吐量测试，持续时间: " << duration << " 秒" << std::endl;
         throughput_test(client, method, params, duration, stats);
+    } else if (test_type == "hedge") {
+        if (!use_discover) {
+            std::cerr << "hedge 测试需要开启服务发现并启动多个服务端" << std::endl;
+            return -1;
+        }
+        std::cout << "对冲测试，请求数: " << requests << std::endl;
+        BenchmarkStats baseline;
+        hedge_test(client, method, params, requests, hedge_delay_ms, baseline, stats);
+        std::cout << "\n---------- 未开启对冲 ----------" << std::endl;
+        baseline.print();
+        std::cout << "---------- 开启对冲 ----------" << std::endl;
+    } else if (test_type == "lb") {
+        if (!use_discover) {
+            std::cerr << "lb 测试需要开启服务发现并启动多个服务端" << std::endl;
+            return -1;
+        }
+        std::cout << "负载均衡对比测试，线程数: " << threads << ", 总请求数: " << requests << std::endl;
+        BenchmarkStats round_robin;
+        lb_test(client, method, params, requests, threads, round_robin, stats);
+        std::cout << "\n---------- ROUND_ROBIN ----------" << std::endl;
+        round_robin.print();
+        std::cout << "---------- P2C_LATENCY ----------" << std::endl;
     } else {
         std::cerr << "未知的测试类型: " << test_type << std::endl;
-        std::cerr << "支持的类型: single, multi, throughput" << std::endl;
+        std::cerr << "支持的类型: single, multi, throughput, hedge, lb" << std::endl;
         return -1;
     }
     
@@ -2,12 +2,26 @@
 #include "../../src/general/detail.hpp"
 #include <chrono>
 #include <thread>
+#include <random>
+
+// 模拟慢节点：每个请求以 g_slow_percent% 的概率额外等待 g_slow_ms 毫秒（用于对冲/负载均衡测试）
+static int g_slow_ms = 0;
+static int g_slow_percent = 0;
+static int g_workers = 0;// 服务执行线程数，0 表示全部在 I/O 线程上执行
+static void maybeSlow()
+{
+    if (g_slow_ms <= 0 || g_slow_percent <= 0) return;
+    thread_local std::mt19937 rng(std::random_device{}());
+    std::uniform_int_distribution<int> dist(0, 99);
+    if (dist(rng) < g_slow_percent) std::this_thread::sleep_for(std::chrono::milliseconds(g_slow_ms));
+}
 
 // 简单的计算服务，用于性能测试
 void add(const Json::Value &req, Json::Value &resp)
 {
     int num1 = req["num1"].asInt();
     int num2 = req["num2"].asInt();
+    maybeSlow();
     resp = num1 + num2;
 }
 
@@ -26,6 +40,7 @@ void heavy_compute(const Json::Value &req, Json::Value &resp)
 // 空操作，测试框架开销
 void echo(const Json::Value &req, Json::Value &resp)
 {
+    maybeSlow();
     resp = req;
 }
 
@@ -44,10 +59,25 @@ int main(int argc, char* argv[])
     if (argc > 3) {
         registry_port = std::atoi(argv[3]);
     }
+    if (argc > 4) {
+        g_slow_ms = std::atoi(argv[4]);
+    }
+    if (argc > 5) {
+        g_slow_percent = std::atoi(argv[5]);
+    }
+    if (argc > 6) {
+        g_workers = std::atoi(argv[6]);
+    }
     
     std::cout << "启动性能测试服务端..." << std::endl;
     std::cout << "端口: " << port << std::endl;
     std::cout << "服务发现: " << (enable_discover ? "启用" : "禁用") << std::endl;
+    if (g_slow_ms > 0 && g_slow_percent > 0) {
+        std::cout << "慢节点模拟: " << g_slow_percent << "% 的请求额外等待 " << g_slow_ms << " ms" << std::endl;
+    }
+    if (g_workers > 0) {
+        std::cout << "服务执行线程: " << g_workers << "（heavy_compute 池化执行，其余在 I/O 线程执行）" << std::endl;
+    }
     
     // 注册 add 服务
     {
@@ -63,6 +93,8 @@ int main(int argc, char* argv[])
             enable_discover,
             lcz_rpc::HostInfo("127.0.0.1", registry_port)
         );
+        // add/echo 这类极短的方法留在 I/O 线程，省去线程切换；只有 heavy_compute 投递到线程池
+        if (g_workers > 0) server.setWorkerPool(static_cast<size_t>(g_workers), lcz_rpc::server::ExecMode::INLINE);
         server.registerMethod(factory->build());
         
         // 注册 echo 服务（空操作）
@@ -82,6 +114,7 @@ int main(int argc, char* argv[])
             heavy_factory->setParamdescribe("value", lcz_rpc::server::ValType::INTEGRAL);
             heavy_factory->setReturntype(lcz_rpc::server::ValType::INTEGRAL);
             heavy_factory->setServiceCallback(heavy_compute);
+            heavy_factory->setExecMode(lcz_rpc::server::ExecMode::POOLED);
             server.registerMethod(heavy_factory->build());
         }
         
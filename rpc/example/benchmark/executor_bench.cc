@@ -0,0 +1,134 @@
+// 服务端执行线程池微基准：工作窃取线程池 vs 单队列（mutex + condvar）线程池
+// 模拟 I/O 线程向线程池投递服务任务：producers 个提交线程各提交 tasks 个任务，每个任务空转 work_ns 纳秒
+#include "../../src/general/executor.hpp"
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+// 对照组：所有工作线程共享一条加锁队列
+class MutexQueueExecutor : public lcz_rpc::Executor
+{
+public:
+    MutexQueueExecutor(size_t threads)
+    {
+        for (size_t i = 0; i < threads; ++i) _threads.emplace_back([this] { run(); });
+    }
+    ~MutexQueueExecutor() override
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _cond.notify_all();
+        for (auto &thread : _threads) thread.join();
+    }
+    using lcz_rpc::Executor::post;
+    void post(Task task) override
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _tasks.push_back(std::move(task));
+        }
+        _cond.notify_one();
+    }
+
+private:
+    void run()
+    {
+        while (true)
+        {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cond.wait(lock, [this] { return _stop || !_tasks.empty(); });
+                if (_tasks.empty()) return;
+                task = std::move(_tasks.front());
+                _tasks.pop_front();
+            }
+            task();
+        }
+    }
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::deque<Task> _tasks;
+    bool _stop = false;
+    std::vector<std::thread> _threads;
+};
+
+static void spin(int work_ns)
+{
+    auto end = std::chrono::steady_clock::now() + std::chrono::nanoseconds(work_ns);
+    while (std::chrono::steady_clock::now() < end) {}
+}
+
+// 返回每秒完成的任务数
+static double runBench(lcz_rpc::Executor &executor, int producers, int tasks, int work_ns)
+{
+    std::atomic<int64_t> done{0};
+    const int64_t total = static_cast<int64_t>(producers) * tasks;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&executor, &done, tasks, work_ns] {
+            for (int i = 0; i < tasks; ++i)
+            {
+                executor.post([&done, work_ns] {
+                    if (work_ns > 0) spin(work_ns);
+                    done.fetch_add(1, std::memory_order_relaxed);
+                });
+            }
+        });
+    }
+    for (auto &thread : threads) thread.join();
+    while (done.load(std::memory_order_relaxed) < total) std::this_thread::yield();
+    auto cost = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    return total * 1000000.0 / std::max<int64_t>(cost, 1);
+}
+
+int main(int argc, char *argv[])
+{
+    int workers = 4;
+    int producers = 1;   // 提交线程数，对应服务端 I/O 线程数
+    int tasks = 500000;  // 每个提交线程的任务数
+    int work_ns = 0;     // 每个任务的空转时间
+
+    if (argc > 1) workers = std::atoi(argv[1]);
+    if (argc > 2) producers = std::atoi(argv[2]);
+    if (argc > 3) tasks = std::atoi(argv[3]);
+    if (argc > 4) work_ns = std::atoi(argv[4]);
+
+    std::cout << "========== 执行线程池微基准 ==========" << std::endl;
+    std::cout << "工作线程: " << workers << " 提交线程: " << producers
+              << " 任务数: " << producers * tasks << " 单任务耗时: " << work_ns << " ns" << std::endl;
+
+    double mutex_qps = 0;
+    {
+        MutexQueueExecutor executor(workers);
+        mutex_qps = runBench(executor, producers, tasks, work_ns);
+    }
+    double ws_qps = 0;
+    lcz_rpc::WorkStealingExecutor::Stats stats;
+    {
+        lcz_rpc::WorkStealingExecutor executor(workers);
+        ws_qps = runBench(executor, producers, tasks, work_ns);
+        stats = executor.stats();
+    }
+
+    std::cout << std::fixed << std::setprecision(0);
+    std::cout << "mutex+condvar 单队列: " << mutex_qps << " 任务/秒" << std::endl;
+    std::cout << "工作窃取:            " << ws_qps << " 任务/秒" << std::endl;
+    std::cout << std::setprecision(2);
+    std::cout << "加速比: " << ws_qps / mutex_qps << "x" << std::endl;
+    std::cout << "工作窃取统计: 执行=" << stats.executed << " 窃取=" << stats.steals
+              << " 溢出=" << stats.overflows << " 平均等待=" << stats.avg_wait_us << "us"
+              << " 最大等待=" << stats.max_wait_us << "us" << std::endl;
+    return 0;
+}
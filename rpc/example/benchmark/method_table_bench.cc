@@ -0,0 +1,97 @@
+// 方法表查找微基准：加锁的 unordered_map vs 不可变快照按名字查找 vs 按方法 ID 查找
+// threads 个线程并发查找，模拟多个 I/O 线程/工作线程同时派发请求
+#include "../../src/server/rpc_router.hpp"
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <mutex>
+#include <unordered_map>
+
+using lcz_rpc::server::ServiceDescribe;
+
+// 对照组：原来的实现，每次查找加锁并哈希方法名
+class MutexServiceTable
+{
+public:
+    void add(const ServiceDescribe::ptr &service)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _services[service->getMethodname()] = service;
+    }
+    ServiceDescribe::ptr select(const std::string &methodname)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        auto it = _services.find(methodname);
+        return it != _services.end() ? it->second : nullptr;
+    }
+
+private:
+    std::mutex _mutex;
+    std::unordered_map<std::string, ServiceDescribe::ptr> _services;
+};
+
+// 返回每次查找的平均耗时（纳秒，按总墙钟时间 / 总查找次数计）
+template <typename Lookup>
+static double runBench(int threads, int lookups, Lookup lookup)
+{
+    std::atomic<size_t> sink{0};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t] {
+            size_t found = 0;
+            for (int i = 0; i < lookups; ++i)
+            {
+                if (lookup(static_cast<size_t>(i + t))) ++found;
+            }
+            sink.fetch_add(found, std::memory_order_relaxed);
+        });
+    }
+    for (auto &worker : workers) worker.join();
+    auto cost = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    if (sink.load() != static_cast<size_t>(threads) * lookups) std::cout << "查找结果异常" << std::endl;
+    return static_cast<double>(cost) / (static_cast<double>(threads) * lookups);
+}
+
+int main(int argc, char *argv[])
+{
+    int methods = 32;
+    int threads = 4;
+    int lookups = 2000000;  // 每个线程的查找次数
+
+    if (argc > 1) methods = std::atoi(argv[1]);
+    if (argc > 2) threads = std::atoi(argv[2]);
+    if (argc > 3) lookups = std::atoi(argv[3]);
+
+    std::vector<std::string> names;
+    MutexServiceTable mutex_table;
+    lcz_rpc::server::ServiceManager manager;
+    for (int i = 0; i < methods; ++i)
+    {
+        lcz_rpc::server::ServiceFactory factory;
+        factory.setMethodName("service.method_" + std::to_string(i));
+        factory.setReturntype(lcz_rpc::server::ValType::INTEGRAL);
+        factory.setServiceCallback([](const Json::Value &, Json::Value &result) { result = 0; });
+        auto service = factory.build();
+        names.push_back(service->getMethodname());
+        mutex_table.add(service);
+        manager.add(service);
+    }
+    std::vector<lcz_rpc::MethodId> ids;
+    for (const auto &name : names) ids.push_back(manager.methodId(name));
+
+    std::cout << "========== 方法表查找微基准 ==========" << std::endl;
+    std::cout << "方法数: " << methods << " 线程数: " << threads << " 每线程查找: " << lookups << std::endl;
+    double mutex_ns = runBench(threads, lookups, [&](size_t i) { return mutex_table.select(names[i % names.size()]) != nullptr; });
+    double name_ns = runBench(threads, lookups, [&](size_t i) { return manager.select(names[i % names.size()]) != nullptr; });
+    double id_ns = runBench(threads, lookups, [&](size_t i) { return manager.select(ids[i % ids.size()]) != nullptr; });
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "加锁 unordered_map:   " << mutex_ns << " ns/次" << std::endl;
+    std::cout << "快照按名字查找:       " << name_ns << " ns/次" << std::endl;
+    std::cout << "快照按方法 ID 查找:   " << id_ns << " ns/次" << std::endl;
+    return 0;
+}
@@ -0,0 +1,119 @@
+// 快照读取微基准：每对象一把锁 vs std::atomic_load(shared_ptr*) vs RcuPtr::load
+// threads 个线程并发读取 objects 个快照，模拟多个调用线程同时选择主机/查路由；可选一个写线程定期发布新快照
+#include "../../src/general/rcu.hpp"
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <memory>
+
+// 对照组：原来的实现，每个对象一把锁保护当前快照
+class MutexSnapshot
+{
+public:
+    MutexSnapshot() : _value(std::make_shared<const int>(0)) {}
+    std::shared_ptr<const int> load()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return _value;
+    }
+    void store(std::shared_ptr<const int> value)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _value = std::move(value);
+    }
+
+private:
+    std::mutex _mutex;
+    std::shared_ptr<const int> _value;
+};
+
+// 对照组：C++11 的 shared_ptr 原子自由函数（libstdc++ 内部使用进程级的哈希锁池）
+class AtomicFreeSnapshot
+{
+public:
+    AtomicFreeSnapshot() : _value(std::make_shared<const int>(0)) {}
+    std::shared_ptr<const int> load() { return std::atomic_load_explicit(&_value, std::memory_order_acquire); }
+    void store(std::shared_ptr<const int> value) { std::atomic_store_explicit(&_value, std::move(value), std::memory_order_release); }
+
+private:
+    std::shared_ptr<const int> _value;
+};
+
+class RcuSnapshot
+{
+public:
+    RcuSnapshot() : _value(std::make_shared<const int>(0)) {}
+    std::shared_ptr<const int> load() { return _value.load(); }
+    void store(std::shared_ptr<const int> value) { _value.store(std::move(value)); }
+
+private:
+    lcz_rpc::RcuPtr<int> _value;
+};
+
+// 返回每次读取的平均耗时（纳秒，按总墙钟时间 / 总读取次数计）；write_us > 0 时另有一个写线程每隔 write_us 微秒发布一次
+template <typename Snapshot>
+static double runBench(int objects, int threads, int reads, int write_us)
+{
+    std::vector<std::unique_ptr<Snapshot>> snapshots;
+    for (int i = 0; i < objects; ++i) snapshots.emplace_back(new Snapshot());
+    std::atomic<bool> stop{false};
+    std::thread writer;
+    if (write_us > 0)
+    {
+        writer = std::thread([&] {
+            for (int v = 1; !stop.load(std::memory_order_relaxed); ++v)
+            {
+                snapshots[v % objects]->store(std::make_shared<const int>(v));
+                std::this_thread::sleep_for(std::chrono::microseconds(write_us));
+            }
+        });
+    }
+    std::atomic<long long> sink{0};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> readers;
+    for (int t = 0; t < threads; ++t)
+    {
+        readers.emplace_back([&, t] {
+            long long sum = 0;
+            for (int i = 0; i < reads; ++i) sum += *snapshots[(i + t) % objects]->load();
+            sink.fetch_add(sum, std::memory_order_relaxed);
+        });
+    }
+    for (auto &reader : readers) reader.join();
+    auto cost = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    stop.store(true);
+    if (writer.joinable()) writer.join();
+    return static_cast<double>(cost) / (static_cast<double>(threads) * reads);
+}
+
+int main(int argc, char *argv[])
+{
+    int objects = 8;
+    int threads = 4;
+    int reads = 2000000;  // 每个线程的读取次数
+    int write_us = 0;     // 写线程的发布间隔（微秒），0 表示只读
+
+    if (argc > 1) objects = std::atoi(argv[1]);
+    if (argc > 2) threads = std::atoi(argv[2]);
+    if (argc > 3) reads = std::atoi(argv[3]);
+    if (argc > 4) write_us = std::atoi(argv[4]);
+
+    std::cout << "========== 快照读取微基准 ==========" << std::endl;
+    std::cout << "对象数: " << objects << " 线程数: " << threads << " 每线程读取: " << reads
+              << " 写间隔: " << write_us << "us" << std::endl;
+    std::shared_ptr<const int> probe;
+    std::cout << "std::atomic_is_lock_free(shared_ptr*): " << std::atomic_is_lock_free(&probe) << std::endl;
+    double mutex_ns = runBench<MutexSnapshot>(objects, threads, reads, write_us);
+    double atomic_ns = runBench<AtomicFreeSnapshot>(objects, threads, reads, write_us);
+    double rcu_ns = runBench<RcuSnapshot>(objects, threads, reads, write_us);
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "每对象一把锁:            " << mutex_ns << " ns/次" << std::endl;
+    std::cout << "std::atomic_load:        " << atomic_ns << " ns/次" << std::endl;
+    std::cout << "RcuPtr::load:            " << rcu_ns << " ns/次" << std::endl;
+    return 0;
+}
@@ -0,0 +1,73 @@
+#pragma once
+/*C++20 协程接口：co_await client.async_call(...)
+发起时机：在 await_suspend 中才真正发送请求，保证协程句柄先于响应登记
+完成竞争：响应回调与 await_suspend 通过原子状态竞争，后到的一方负责恢复协程
+恢复策略：默认在响应所在的 I/O 线程内联恢复，也可以传入执行器把恢复投递到其他线程
+*/
+#include "caller.hpp"
+#include "../general/publicconfig.hpp"
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#include <atomic>
+#define LCZ_RPC_HAS_COROUTINE 1
+
+namespace lcz_rpc
+{
+    namespace client
+    {
+        class RpcAwaitable
+        {
+        public:
+            // 协程恢复执行器：为空时在 I/O 线程内联恢复
+            using ResumeExecutor = std::function<void(std::function<void()>)>;
+            // 发起请求：把状态回调交给调用方完成实际发送，返回 false 表示未能发出
+            using Launcher = std::function<bool(const RpcCaller::StatusCallback &)>;
+
+            RpcAwaitable(Launcher launcher, ResumeExecutor executor = nullptr)
+                : _state(std::make_shared<State>())
+            {
+                _state->launcher = std::move(launcher);
+                _state->executor = std::move(executor);
+            }
+            bool await_ready() const noexcept { return false; }
+            // 返回 false 表示结果已就绪（或发送失败），协程不挂起直接继续
+            bool await_suspend(std::coroutine_handle<> handle)
+            {
+                _state->handle = handle;
+                auto state = _state;
+                bool ret = state->launcher([state](RespCode rcode, const Json::Value &result) {
+                    state->result.rcode = rcode;
+                    state->result.result = result;
+                    if (state->stage.exchange(kDone) == kSuspended) // await_suspend 已返回，由这里负责恢复
+                    {
+                        if (state->executor) state->executor([state] { state->handle.resume(); });
+                        else state->handle.resume();
+                    }
+                });
+                if (!ret)
+                {
+                    state->result.rcode = RespCode::CONNECTION_CLOSED;
+                    return false;
+                }
+                int expected = kPending;
+                // 响应已经先到，不挂起；否则标记为已挂起，交给回调恢复
+                return state->stage.compare_exchange_strong(expected, kSuspended);
+            }
+            RpcCaller::RpcResult await_resume() { return std::move(_state->result); }
+
+        private:
+            enum { kPending = 0, kSuspended, kDone };
+            struct State
+            {
+                std::atomic<int> stage{kPending};
+                std::coroutine_handle<> handle;
+                RpcCaller::RpcResult result;
+                Launcher launcher;
+                ResumeExecutor executor;
+            };
+            std::shared_ptr<State> _state;
+        };
+    }
+}
+#endif
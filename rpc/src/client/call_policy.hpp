@@ -0,0 +1,428 @@
+#pragma once
+/*客户端按方法配置的调用策略
+RequestBudget：令牌预算，正常请求按比例存入令牌，额外请求（对冲/重试）取出令牌，限制放大倍数
+LatencyWindow：最近 N 个成功请求的延迟样本，用于估计自适应分位数
+HedgePolicy/HedgeState：对冲请求配置与运行状态
+RetryPolicy/RetryState：失败重试配置与运行状态
+RequestKey：请求参数的规范化键与哈希，供合并与缓存共用
+CoalesceState：相同请求合并（singleflight）的在途表
+CachePolicy/ResponseCache：幂等方法的客户端响应缓存（分片 LRU + TTL）
+*/
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <sstream>
+#include <functional>
+#include <unordered_map>
+#include <list>
+#include <jsoncpp/json/json.h>
+#include "../general/fields.hpp"
+#include "../general/publicconfig.hpp"
+
+namespace lcz_rpc
+{
+    namespace client
+    {
+        // 令牌预算：每个正常请求存入 ratio 个令牌，每个额外请求消耗 1 个，余额上限 max_tokens
+        // 初始即为满额（与 gRPC 重试限流相同）：刚启动的进程和低频调用方也能立即重试/对冲，持续失败时才被比例限制住
+        class RequestBudget
+        {
+        public:
+            RequestBudget(double ratio, double max_tokens = 10.0)
+                : _ratio_milli(static_cast<int64_t>(ratio * kScale)),
+                  _max_milli(static_cast<int64_t>(max_tokens * kScale)),
+                  _tokens_milli(_max_milli) {}
+            // 正常请求到达时存入令牌
+            void deposit()
+            {
+                int64_t cur = _tokens_milli.load(std::memory_order_relaxed);
+                int64_t next;
+                do
+                {
+                    next = std::min(cur + _ratio_milli, _max_milli);
+                } while (!_tokens_milli.compare_exchange_weak(cur, next, std::memory_order_relaxed));
+            }
+            // 额外请求发出前取令牌，余额不足返回 false
+            bool withdraw()
+            {
+                int64_t cur = _tokens_milli.load(std::memory_order_relaxed);
+                do
+                {
+                    if (cur < kScale) return false;
+                } while (!_tokens_milli.compare_exchange_weak(cur, cur - kScale, std::memory_order_relaxed));
+                return true;
+            }
+
+        private:
+            static constexpr int64_t kScale = 1000; // 以千分之一令牌为单位，避免浮点原子操作
+            int64_t _ratio_milli;
+            int64_t _max_milli;
+            std::atomic<int64_t> _tokens_milli;
+        };
+
+        // 延迟样本环形窗口，分位数按需重算并缓存
+        class LatencyWindow
+        {
+        public:
+            LatencyWindow(size_t capacity = 256) : _samples(capacity, 0) {}
+            void record(int64_t latency_us)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _samples[_next] = latency_us;
+                _next = (_next + 1) % _samples.size();
+                if (_count < _samples.size()) ++_count;
+                if (++_since_update >= kUpdateEvery) refresh();
+            }
+            // 返回最近一次计算的 p95，样本不足时返回 0
+            int64_t p95()
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                return _p95_us;
+            }
+
+        private:
+            void refresh()
+            {
+                _since_update = 0;
+                if (_count < kMinSamples) return;
+                std::vector<int64_t> sorted(_samples.begin(), _samples.begin() + _count);
+                size_t pos = _count * 95 / 100;
+                std::nth_element(sorted.begin(), sorted.begin() + pos, sorted.end());
+                _p95_us = sorted[pos];
+            }
+            static constexpr size_t kUpdateEvery = 16;// 每 16 个样本重算一次分位数
+            static constexpr size_t kMinSamples = 20;
+            std::mutex _mutex;
+            std::vector<int64_t> _samples;
+            size_t _next = 0;
+            size_t _count = 0;
+            size_t _since_update = 0;
+            int64_t _p95_us = 0;
+        };
+
+        // 对冲配置：只应用于幂等方法
+        struct HedgePolicy
+        {
+            int delay_ms = 0;            // 固定对冲延迟；<=0 时使用自适应 p95
+            int min_delay_ms = 1;        // 自适应延迟下限，防止过早对冲
+            int initial_delay_ms = 10;   // 自适应模式下样本不足时使用的延迟
+            double budget_ratio = 0.05;  // 对冲请求最多占正常请求的比例
+        };
+
+        // 单个方法的对冲运行状态
+        class HedgeState
+        {
+        public:
+            using ptr = std::shared_ptr<HedgeState>;
+            struct Stats
+            {
+                uint64_t requests = 0;   // 正常请求数
+                uint64_t hedges = 0;     // 发出的对冲请求数
+                uint64_t hedge_wins = 0; // 对冲请求先返回的次数
+            };
+            HedgeState(const HedgePolicy &policy) : _policy(policy), _budget(policy.budget_ratio) {}
+            // 正常请求发出
+            void onRequest()
+            {
+                _requests.fetch_add(1, std::memory_order_relaxed);
+                _budget.deposit();
+            }
+            // 准备发出对冲请求：受预算限制
+            bool tryHedge()
+            {
+                if (!_budget.withdraw()) return false;
+                _hedges.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            void onHedgeWin() { _hedge_wins.fetch_add(1, std::memory_order_relaxed); }
+            void recordLatency(int64_t latency_us) { _latency.record(latency_us); }
+            // 本次请求应等待多久再对冲（微秒）
+            int64_t delayUs()
+            {
+                if (_policy.delay_ms > 0) return static_cast<int64_t>(_policy.delay_ms) * 1000;
+                int64_t p95 = _latency.p95();
+                if (p95 <= 0) return static_cast<int64_t>(_policy.initial_delay_ms) * 1000;
+                return std::max<int64_t>(p95, static_cast<int64_t>(_policy.min_delay_ms) * 1000);
+            }
+            Stats stats() const
+            {
+                Stats st;
+                st.requests = _requests.load(std::memory_order_relaxed);
+                st.hedges = _hedges.load(std::memory_order_relaxed);
+                st.hedge_wins = _hedge_wins.load(std::memory_order_relaxed);
+                return st;
+            }
+
+        private:
+            HedgePolicy _policy;
+            RequestBudget _budget;
+            LatencyWindow _latency;
+            std::atomic<uint64_t> _requests{0};
+            std::atomic<uint64_t> _hedges{0};
+            std::atomic<uint64_t> _hedge_wins{0};
+        };
+
+        // 重试配置：只应用于幂等方法
+        struct RetryPolicy
+        {
+            int max_attempts = 3;        // 最多尝试次数（含首次）
+            int backoff_ms = 10;         // 首次重试前的退避，之后每次翻倍
+            int max_backoff_ms = 200;    // 退避上限
+            double budget_ratio = 0.1;   // 重试请求最多占正常请求的比例，过载时避免重试风暴
+            bool switch_host = true;     // 重试时避开上一次失败的主机（没有其他主机时仍可回到原主机）
+        };
+
+        // 单个方法的重试运行状态
+        class RetryState
+        {
+        public:
+            using ptr = std::shared_ptr<RetryState>;
+            struct Stats
+            {
+                uint64_t requests = 0;        // 正常请求数
+                uint64_t retries = 0;         // 发出的重试次数
+                uint64_t budget_rejected = 0; // 因预算不足放弃的重试次数
+            };
+            RetryState(const RetryPolicy &policy) : _policy(policy), _budget(policy.budget_ratio) {}
+            const RetryPolicy &policy() const { return _policy; }
+            // 只有连接断开、服务端内部错误和过载拒绝视为瞬时故障；参数错误、方法不存在等重试也不会成功
+            static bool retryable(RespCode rcode)
+            {
+                return rcode == RespCode::CONNECTION_CLOSED || rcode == RespCode::INTERNAL_ERROR || rcode == RespCode::OVERLOADED;
+            }
+            void onRequest()
+            {
+                _requests.fetch_add(1, std::memory_order_relaxed);
+                _budget.deposit();
+            }
+            // 准备第 attempt 次尝试（从 2 开始），超出次数或预算不足返回 false
+            bool tryRetry(int attempt)
+            {
+                if (attempt > _policy.max_attempts) return false;
+                if (!_budget.withdraw())
+                {
+                    _budget_rejected.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                _retries.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            // 第 attempt 次尝试前的退避（毫秒）：指数增长，取 [一半, 全部] 之间的随机值打散同时失败的请求
+            int backoffMs(int attempt) const
+            {
+                int64_t backoff = _policy.backoff_ms;
+                for (int i = 2; i < attempt && backoff < _policy.max_backoff_ms; ++i) backoff *= 2;
+                backoff = std::min<int64_t>(backoff, _policy.max_backoff_ms);
+                if (backoff <= 1) return static_cast<int>(std::max<int64_t>(backoff, 0));
+                thread_local std::mt19937 generator(std::random_device{}());
+                std::uniform_int_distribution<int64_t> dist(backoff / 2, backoff);
+                return static_cast<int>(dist(generator));
+            }
+            Stats stats() const
+            {
+                Stats st;
+                st.requests = _requests.load(std::memory_order_relaxed);
+                st.retries = _retries.load(std::memory_order_relaxed);
+                st.budget_rejected = _budget_rejected.load(std::memory_order_relaxed);
+                return st;
+            }
+
+        private:
+            RetryPolicy _policy;
+            RequestBudget _budget;
+            std::atomic<uint64_t> _requests{0};
+            std::atomic<uint64_t> _retries{0};
+            std::atomic<uint64_t> _budget_rejected{0};
+        };
+
+        // 请求键：规范化后的参数，同一方法下相同的键代表相同的请求
+        struct RequestKey
+        {
+            // jsoncpp 的对象按键名有序存储，紧凑输出即规范形式；hash_key 不同的请求视为不同请求
+            static std::string make(const Json::Value &params, const std::string &hash_key)
+            {
+                thread_local std::unique_ptr<Json::StreamWriter> writer = [] {
+                    Json::StreamWriterBuilder swb;
+                    swb["indentation"] = "";
+                    return std::unique_ptr<Json::StreamWriter>(swb.newStreamWriter());
+                }();
+                std::ostringstream ss;
+                writer->write(params, &ss);
+                ss << '\0' << hash_key;
+                return ss.str();
+            }
+            // FNV-1a 64 位：键是序列化后的参数，一次线性扫描即可，比逐字段比较 Json::Value 快得多
+            struct Hash
+            {
+                size_t operator()(const std::string &key) const
+                {
+                    uint64_t h = 14695981039346656037ull;
+                    for (unsigned char c : key)
+                    {
+                        h ^= c;
+                        h *= 1099511628211ull;
+                    }
+                    return static_cast<size_t>(h);
+                }
+            };
+        };
+
+        // 相同请求合并：同一方法、相同参数的请求在途时，后来的调用挂到在途请求上，响应到达后一起分发
+        // 只应用于幂等方法；合并的是"正在进行的"请求，请求完成后立即出表，不缓存结果
+        class CoalesceState
+        {
+        public:
+            using ptr = std::shared_ptr<CoalesceState>;
+            using Callback = std::function<void(RespCode, const Json::Value &)>;
+            struct Stats
+            {
+                uint64_t requests = 0;  // 进入合并层的调用数
+                uint64_t coalesced = 0; // 挂到在途请求上、没有单独发出的调用数
+            };
+            // 登记一次调用（key 由 RequestKey::make 生成）：返回 true 表示没有相同请求在途，调用方负责真正发出请求并在完成时调用 finish
+            bool join(const std::string &key, const Callback &cb)
+            {
+                _requests.fetch_add(1, std::memory_order_relaxed);
+                std::unique_lock<std::mutex> lock(_mutex);
+                auto &waiters = _flights[key];
+                waiters.push_back(cb);
+                if (waiters.size() == 1) return true;
+                _coalesced.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            // 在途请求结束：摘除该键并取出全部等待者（第一个是发起者自己），由调用方在锁外分发
+            std::vector<Callback> finish(const std::string &key)
+            {
+                std::vector<Callback> waiters;
+                std::unique_lock<std::mutex> lock(_mutex);
+                auto it = _flights.find(key);
+                if (it == _flights.end()) return waiters;
+                waiters.swap(it->second);
+                _flights.erase(it);
+                return waiters;
+            }
+            Stats stats() const
+            {
+                Stats st;
+                st.requests = _requests.load(std::memory_order_relaxed);
+                st.coalesced = _coalesced.load(std::memory_order_relaxed);
+                return st;
+            }
+
+        private:
+            std::mutex _mutex;
+            std::unordered_map<std::string, std::vector<Callback>, RequestKey::Hash> _flights;//合并键 -> 等待者，哈希相同的不同参数按键全文比较区分
+            std::atomic<uint64_t> _requests{0};
+            std::atomic<uint64_t> _coalesced{0};
+        };
+
+        // 响应缓存配置：只应用于结果很少变化的幂等查询方法
+        struct CachePolicy
+        {
+            int ttl_ms = 1000;          // 缓存项有效期，过期后下一次调用重新请求
+            size_t max_entries = 1024;  // 缓存项总数上限，超出时按分片淘汰最久未用的项
+            size_t shards = 16;         // 分片数，不同键的查找落在不同分片上互不竞争
+        };
+
+        // 分片 LRU + TTL 响应缓存：键按哈希分到各分片，每个分片一把锁、一条 LRU 链
+        // 命中路径只有一次哈希、一次分片内查找和一次链表摘挂，远比一次网络往返便宜
+        class ResponseCache
+        {
+        public:
+            using ptr = std::shared_ptr<ResponseCache>;
+            struct Stats
+            {
+                uint64_t hits = 0;
+                uint64_t misses = 0;     // 未命中（含过期）
+                uint64_t evictions = 0;  // 因容量上限被淘汰的项数
+            };
+            ResponseCache(const CachePolicy &policy)
+                : _ttl(std::chrono::milliseconds(std::max(policy.ttl_ms, 0))),
+                  _shards(std::max<size_t>(policy.shards, 1))
+            {
+                _shard_capacity = std::max<size_t>(policy.max_entries / _shards.size(), 1);
+            }
+            // 查找未过期的缓存结果，命中时移到 LRU 链头
+            bool get(const std::string &key, Json::Value &result)
+            {
+                size_t h = RequestKey::Hash()(key);
+                Shard &shard = _shards[h % _shards.size()];
+                auto now = std::chrono::steady_clock::now();
+                std::unique_lock<std::mutex> lock(shard.mutex);
+                auto it = shard.index.find(key);
+                if (it == shard.index.end())
+                {
+                    _misses.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                if (now >= it->second->expire)//过期项直接删除
+                {
+                    shard.lru.erase(it->second);
+                    shard.index.erase(it);
+                    _misses.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+                result = it->second->result;
+                _hits.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            // 写入成功响应：已存在则刷新结果与有效期，分片满时淘汰链尾
+            void put(const std::string &key, const Json::Value &result)
+            {
+                size_t h = RequestKey::Hash()(key);
+                Shard &shard = _shards[h % _shards.size()];
+                auto expire = std::chrono::steady_clock::now() + _ttl;
+                std::unique_lock<std::mutex> lock(shard.mutex);
+                auto it = shard.index.find(key);
+                if (it != shard.index.end())
+                {
+                    it->second->result = result;
+                    it->second->expire = expire;
+                    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+                    return;
+                }
+                shard.lru.push_front(Entry{key, result, expire});
+                shard.index.emplace(key, shard.lru.begin());
+                while (shard.lru.size() > _shard_capacity)
+                {
+                    shard.index.erase(shard.lru.back().key);
+                    shard.lru.pop_back();
+                    _evictions.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            Stats stats() const
+            {
+                Stats st;
+                st.hits = _hits.load(std::memory_order_relaxed);
+                st.misses = _misses.load(std::memory_order_relaxed);
+                st.evictions = _evictions.load(std::memory_order_relaxed);
+                return st;
+            }
+
+        private:
+            struct Entry
+            {
+                std::string key;
+                Json::Value result;
+                std::chrono::steady_clock::time_point expire;
+            };
+            struct Shard
+            {
+                std::mutex mutex;
+                std::list<Entry> lru;//链头最近使用
+                std::unordered_map<std::string, std::list<Entry>::iterator, RequestKey::Hash> index;
+            };
+            std::chrono::steady_clock::duration _ttl;
+            std::vector<Shard> _shards;
+            size_t _shard_capacity;
+            std::atomic<uint64_t> _hits{0};
+            std::atomic<uint64_t> _misses{0};
+            std::atomic<uint64_t> _evictions{0};
+        };
+    }
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "requestor.hpp"
+#include "../general/future.hpp"
 #include<future>
 #include<functional>
 #include "../general/publicconfig.hpp"
@@ -15,8 +16,24 @@ namespace lcz_rpc
         {
             public:
             using ptr=std::shared_ptr<RpcCaller>;
-            using RpcAsyncRespose=std::future<Json::Value>;
+            using RpcAsyncRespose=Future<Json::Value>;//可组合 future：支持 then/whenAll/whenAny，失败时携带错误码
             using ResponseCallback=std::function<void(const Json::Value&)>;
+            //批量调用：(方法名, 参数) 列表
+            using BatchRequest=std::vector<std::pair<std::string,Json::Value>>;
+            //带状态码的调用结果：rcode 不为 SUCCESS 时 result 无意义
+            struct RpcResult
+            {
+                RespCode rcode=RespCode::INTERNAL_ERROR;
+                Json::Value result;
+                bool ok()const{return rcode==RespCode::SUCCESS;}
+            };
+            //携带状态码的回调：失败时同样会被触发
+            using StatusCallback=std::function<void(RespCode rcode,const Json::Value& result)>;
+            //批量调用中单个请求的结果
+            using BatchReply=RpcResult;
+            using BatchCallback=std::function<void(std::vector<BatchReply>&)>;
+            //批量调用内部回调：idx 为请求在 BatchRequest 中的下标
+            using BatchReplyCallback=std::function<void(size_t idx,RespCode rcode,const Json::Value& result)>;
             RpcCaller(const Requestor::ptr& reqtor):_requestor(reqtor){}
             // 同步调用：阻塞等待响应，返回结果 Json::Value
             bool call(const BaseConnection::ptr& conn,const std::string& method_name,const Json::Value& params,Json::Value& result)
@@ -25,7 +42,7 @@ namespace lcz_rpc
                 RpcRequest::ptr req_msg=MessageFactory::create<RpcRequest>();
                 req_msg->setId(uuid());
                 req_msg->setMsgType(MsgType::REQ_RPC);
-                req_msg->setMethod(method_name);
+                setMethod(conn,req_msg,method_name);
                 req_msg->setParams(params);
                 BaseMessage::ptr resp_msg;
                 bool ret= _requestor->send(conn,std::dynamic_pointer_cast<BaseMessage>(req_msg),resp_msg);
@@ -43,7 +60,7 @@ namespace lcz_rpc
                 DLOG("RpcCaller sync call finish method=%s", method_name.c_str());
                 return true;
             }
-            // 异步调用：返回 std::future，由调用者自行等待
+            // 异步调用：返回可组合 future，由调用者等待或用 then 串联后续
             bool call(const BaseConnection::ptr& conn, const std::string& method_name,Json::Value& params,RpcAsyncRespose& result)
             {
                 DLOG("RpcCaller future call method=%s", method_name.c_str());
@@ -51,16 +68,15 @@ namespace lcz_rpc
                 auto req_msg=MessageFactory::create<RpcRequest>();
                 req_msg->setId(uuid());
                 req_msg->setMsgType(MsgType::REQ_RPC);
-                req_msg->setMethod(method_name);
+                setMethod(conn,req_msg,method_name);
                 req_msg->setParams(params);
-                BaseMessage::ptr resp_msg;
                 
-                auto json_pomise=std::make_shared<std::promise<Json::Value>>();//防止作用域结束销毁
-                result=json_pomise->get_future();///创建 Promise-Future 对，通过 get_future() 连接
+                Promise<Json::Value> json_promise;//与 future 共用一块共享状态，按值捕获即可
+                result=json_promise.future();
 
-                Requestor::ReqCallback cb=std::bind(&RpcCaller::callBack,this,json_pomise,std::placeholders::_1);
+                Requestor::ReqCallback cb=std::bind(&RpcCaller::callBack,this,json_promise,std::placeholders::_1);
                 bool ret= _requestor->send(conn,std::dynamic_pointer_cast<BaseMessage>(req_msg),cb);
-                if(!ret){ELOG("rpc异步请求失败");return false;}
+                if(!ret){ELOG("rpc异步请求失败");json_promise.setError(RespCode::CONNECTION_CLOSED);return false;}
 
                 return true;
 
@@ -72,7 +88,7 @@ namespace lcz_rpc
                 auto req_msg=MessageFactory::create<RpcRequest>();
                 req_msg->setId(uuid());
                 req_msg->setMsgType(MsgType::REQ_RPC);
-                req_msg->setMethod(method_name);
+                setMethod(conn,req_msg,method_name);
                 req_msg->setParams(params);
                 BaseMessage::ptr resp_msg;
                
@@ -82,20 +98,116 @@ namespace lcz_rpc
 
                 return true;
             }
+            // 状态回调模式：成功与失败都会触发 cb，供协程/组合式 future 等上层封装使用
+            bool call(const BaseConnection::ptr& conn, const std::string& method_name,const Json::Value& params,const StatusCallback& cb)
+            {
+                DLOG("RpcCaller status call method=%s", method_name.c_str());
+                auto req_msg=MessageFactory::create<RpcRequest>();
+                req_msg->setId(uuid());
+                req_msg->setMsgType(MsgType::REQ_RPC);
+                setMethod(conn,req_msg,method_name);
+                req_msg->setParams(params);
+
+                Requestor::ReqCallback reqcb=std::bind(&RpcCaller::callBackstatus,this,cb,std::placeholders::_1);
+                bool ret= _requestor->send(conn,std::dynamic_pointer_cast<BaseMessage>(req_msg),reqcb);
+                if(!ret){ELOG("rpc状态回调请求失败");return false;}
+                return true;
+            }
+            // 批量调用：把 calls 中 idxs 指定的请求合并成一次写发往同一连接，每个响应到达时触发 cb(idx,...)
+            bool callBatch(const BaseConnection::ptr& conn,const BatchRequest& calls,const std::vector<size_t>& idxs,const BatchReplyCallback& cb)
+            {
+                DLOG("RpcCaller batch call size=%zu", idxs.size());
+                std::vector<BaseMessage::ptr> reqs;
+                std::vector<Requestor::ReqCallback> reqcbs;
+                reqs.reserve(idxs.size());
+                reqcbs.reserve(idxs.size());
+                for(size_t idx:idxs)
+                {
+                    auto req_msg=MessageFactory::create<RpcRequest>();
+                    req_msg->setId(uuid());
+                    req_msg->setMsgType(MsgType::REQ_RPC);
+                    setMethod(conn,req_msg,calls[idx].first);
+                    req_msg->setParams(calls[idx].second);
+                    reqs.emplace_back(req_msg);
+                    reqcbs.emplace_back(std::bind(&RpcCaller::callBackbatch,this,cb,idx,std::placeholders::_1));
+                }
+                bool ret=_requestor->send(conn,reqs,reqcbs);
+                if(!ret){ELOG("rpc批量请求失败");return false;}
+                return true;
+            }
+            // 握手：向对端索取方法 ID 表，记在连接上，之后发往该连接的请求在帧头携带 ID 而不是方法名
+            // 异步进行，应答到达前的请求照常按方法名发送；旧版本服务端不认识 METHOD_LIST，回 SERVICE_NOT_FOUND，该连接保持按方法名发送
+            bool handshake(const BaseConnection::ptr& conn)
+            {
+                if(conn.get()==nullptr||conn->methodIds()!=nullptr)return false;
+                std::weak_ptr<BaseConnection> weak_conn=conn;
+                return call(conn,METHOD_LIST,Json::Value(Json::objectValue),StatusCallback([weak_conn](RespCode rcode,const Json::Value& result){
+                    auto conn=weak_conn.lock();
+                    if(conn.get()==nullptr||rcode!=RespCode::SUCCESS||result.isObject()==false)return;
+                    auto ids=std::make_shared<MethodIdTable>();
+                    for(const auto& name:result.getMemberNames())
+                    {
+                        if(result[name].isUInt())(*ids)[name]=result[name].asUInt();
+                    }
+                    conn->setMethodIds(ids);
+                    DLOG("方法 ID 握手完成,方法数:%zu",ids->size());
+                }));
+            }
             private:
-            // future 模式下的回调：校验响应并设置 promise
-            void callBack(std::shared_ptr<std::promise<Json::Value>> result,const BaseMessage::ptr& msg)
+            // 对端在握手中给出了该方法的 ID 时只在帧头携带 ID，否则按方法名发送（未握手、旧版本服务端、握手后才注册的方法）
+            static void setMethod(const BaseConnection::ptr& conn,const RpcRequest::ptr& req,const std::string& method_name)
+            {
+                const MethodIdTable* ids=conn->methodIds();
+                if(ids!=nullptr)
+                {
+                    auto it=ids->find(method_name);
+                    if(it!=ids->end())
+                    {
+                        req->setMethodId(it->second);
+                        return;
+                    }
+                }
+                req->setMethod(method_name);
+            }
+            // 状态回调模式：把响应码连同结果一起交给 cb
+            void callBackstatus(const StatusCallback &cb,const BaseMessage::ptr& msg)
             {
                 RpcResponse::ptr rpc_respmsg=std::dynamic_pointer_cast<RpcResponse>(msg);
                 if(rpc_respmsg.get()==nullptr)
                 {
-                ELOG("类型向下转换失败失败");return ; 
+                    ELOG("类型向下转换失败失败");
+                    return cb(RespCode::INVALID_MSG,Json::Value());
+                }
+                cb(rpc_respmsg->rcode(),rpc_respmsg->result());
+            }
+            // 批量模式：无论成功失败都要回报，否则整批永远等不到完成
+            void callBackbatch(const BatchReplyCallback &cb,size_t idx,const BaseMessage::ptr& msg)
+            {
+                RpcResponse::ptr rpc_respmsg=std::dynamic_pointer_cast<RpcResponse>(msg);
+                if(rpc_respmsg.get()==nullptr)
+                {
+                    ELOG("类型向下转换失败失败");
+                    return cb(idx,RespCode::INVALID_MSG,Json::Value());
+                }
+                if(rpc_respmsg->rcode()!=RespCode::SUCCESS)
+                {
+                    ELOG("rpc批量出错：%s",errReason(rpc_respmsg->rcode()).c_str());
+                }
+                cb(idx,rpc_respmsg->rcode(),rpc_respmsg->result());
+            }
+            // future 模式下的回调：校验响应并完成 promise，失败也必须完成，否则等待方会永久阻塞
+            void callBack(const Promise<Json::Value>& result,const BaseMessage::ptr& msg)
+            {
+                RpcResponse::ptr rpc_respmsg=std::dynamic_pointer_cast<RpcResponse>(msg);
+                if(rpc_respmsg.get()==nullptr)
+                {
+                    ELOG("类型向下转换失败失败");result.setError(RespCode::INVALID_MSG);return ; 
                 }
                 if(rpc_respmsg->rcode()!=RespCode::SUCCESS)
                 {
-                    ELOG("rpc异步出错：%s",errReason(rpc_respmsg->rcode()).c_str());return; 
+                    ELOG("rpc异步出错：%s",errReason(rpc_respmsg->rcode()).c_str());result.setError(rpc_respmsg->rcode());return; 
                 }
-                result->set_value(rpc_respmsg->result());//被触发时设置结果
+                result.setValue(rpc_respmsg->result());//被触发时设置结果
             }
             // 回调模式：校验响应后，执行用户提供的 cb
             void callBackself(const ResponseCallback &cb,const BaseMessage::ptr& msg)
@@ -0,0 +1,101 @@
+#pragma once
+/*一致性哈希环（ketama 风格）
+每台主机在环上放置 kVirtualNodes 个虚拟节点，key 顺时针找到的第一个虚拟节点即目标主机
+增删主机只移动该主机自己的虚拟节点，约 1/N 的 key 改变归属，其余 key 保持原主机（提供者本地缓存保持命中）
+*/
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+#include "../general/publicconfig.hpp"
+
+namespace lcz_rpc
+{
+    namespace client
+    {
+        class HashRing
+        {
+        public:
+            static constexpr int kVirtualNodes = 160; //每台主机的虚拟节点数，越多分布越均匀
+
+            //加入主机：生成该主机的虚拟节点并归并进有序环，已存在则忽略
+            void addHost(const HostInfo &host)
+            {
+                if (contains(host)) return;
+                std::vector<Node> nodes;
+                nodes.reserve(kVirtualNodes);
+                std::string prefix = host.first + ":" + std::to_string(host.second) + "#";
+                for (int i = 0; i < kVirtualNodes; ++i)
+                {
+                    nodes.push_back(Node{hash(prefix + std::to_string(i)), host});
+                }
+                std::sort(nodes.begin(), nodes.end());
+                std::vector<Node> merged;
+                merged.reserve(_nodes.size() + nodes.size());
+                std::merge(_nodes.begin(), _nodes.end(), nodes.begin(), nodes.end(), std::back_inserter(merged));
+                _nodes.swap(merged);
+            }
+            //移除主机的全部虚拟节点，其他节点位置不变
+            void removeHost(const HostInfo &host)
+            {
+                _nodes.erase(std::remove_if(_nodes.begin(), _nodes.end(), [&](const Node &node) { return node.host == host; }),
+                             _nodes.end());
+            }
+            bool empty() const { return _nodes.empty(); }
+            //定位 key 所属主机：从 key 的位置顺时针查找第一个满足 accept 的虚拟节点
+            //accept 用于跳过被摘除/需要避开的主机，这些主机的 key 落到环上的下一台，其他 key 不受影响
+            template <typename Accept>
+            bool locate(const std::string &key, Accept accept, HostInfo &host) const
+            {
+                if (_nodes.empty()) return false;
+                uint32_t point = hash(key);
+                auto start = std::lower_bound(_nodes.begin(), _nodes.end(), point,
+                                              [](const Node &node, uint32_t value) { return node.point < value; });
+                size_t begin = static_cast<size_t>(start - _nodes.begin());
+                for (size_t i = 0; i < _nodes.size(); ++i)
+                {
+                    const Node &node = _nodes[(begin + i) % _nodes.size()];
+                    if (accept(node.host))
+                    {
+                        host = node.host;
+                        return true;
+                    }
+                }
+                return false;
+            }
+            //FNV-1a 之后做一次 murmur3 fmix32 混合，让相近的虚拟节点名也能均匀散开
+            static uint32_t hash(const std::string &key)
+            {
+                uint32_t h = 2166136261u;
+                for (unsigned char c : key)
+                {
+                    h ^= c;
+                    h *= 16777619u;
+                }
+                h ^= h >> 16;
+                h *= 0x85ebca6bu;
+                h ^= h >> 13;
+                h *= 0xc2b2ae35u;
+                h ^= h >> 16;
+                return h;
+            }
+
+        private:
+            struct Node
+            {
+                uint32_t point;
+                HostInfo host;
+                bool operator<(const Node &other) const
+                {
+                    if (point != other.point) return point < other.point;
+                    return host < other.host;//哈希冲突时按主机排序，保证各客户端的环一致
+                }
+            };
+            bool contains(const HostInfo &host) const
+            {
+                return std::any_of(_nodes.begin(), _nodes.end(), [&](const Node &node) { return node.host == host; });
+            }
+            std::vector<Node> _nodes;//按 point 有序
+        };
+    }
+}
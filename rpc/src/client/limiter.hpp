@@ -0,0 +1,156 @@
+#pragma once
+/*按主机的自适应并发限制（gradient 算法）
+上限随测得的延迟调整：短期延迟明显高于长期基线说明对端开始排队，按比例收缩；延迟平稳时缓慢增长
+超出上限的请求在本地短暂排队，队列满或排队超时的请求直接失败，不再堆积到对端和 Requestor 的等待表里
+*/
+#include <mutex>
+#include <deque>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace lcz_rpc
+{
+    namespace client
+    {
+        // 并发限制配置，对开启后的每台主机分别生效
+        struct LimiterPolicy
+        {
+            int initial_limit = 20;      // 初始并发上限
+            int min_limit = 4;           // 上限下界，过载时仍保留少量并发用于探测恢复
+            int max_limit = 1000;        // 上限上界
+            double tolerance = 1.5;      // 短期延迟超过长期基线的这个倍数才开始收缩
+            double smoothing = 0.2;      // 每个样本对上限的调整幅度
+            double backoff_ratio = 0.9;  // 请求失败（连接断开/过载）时上限乘以该系数
+            size_t max_queue = 100;      // 超出上限的请求最多排队数，0 表示直接拒绝
+            int queue_timeout_ms = 50;   // 排队超时
+        };
+
+        class ConcurrencyLimiter
+        {
+        public:
+            using ptr = std::shared_ptr<ConcurrencyLimiter>;
+            using Task = std::function<void(bool admitted)>;// admitted 为 false 表示队列满或排队超时
+            struct Stats
+            {
+                int limit = 0;           // 当前并发上限
+                int inflight = 0;        // 在途请求数
+                size_t queued = 0;       // 排队中的请求数
+                uint64_t rejected = 0;   // 队列满或排队超时被拒绝的请求数
+                double short_rtt_us = 0; // 短期延迟
+                double long_rtt_us = 0;  // 长期延迟基线
+            };
+            ConcurrencyLimiter(const LimiterPolicy &policy)
+                : _policy(policy), _limit(std::max(policy.initial_limit, std::max(policy.min_limit, 1))) {}
+            // 申请一个并发名额：有空余时立即执行 task(true)，否则排队；task 总是在锁外执行
+            void submit(const Task &task)
+            {
+                std::vector<Task> expired;
+                bool admitted = false;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    takeExpired(std::chrono::steady_clock::now(), expired);
+                    if (_inflight < static_cast<int>(_limit))
+                    {
+                        ++_inflight;
+                        admitted = true;
+                    }
+                    else if (_queue.size() < _policy.max_queue)
+                    {
+                        _queue.push_back(Waiter{task, std::chrono::steady_clock::now()});
+                    }
+                    else
+                    {
+                        ++_rejected;
+                        expired.push_back(task);
+                    }
+                }
+                for (auto &item : expired) item(false);
+                if (admitted) task(true);
+            }
+            // 请求完成：用延迟样本调整上限，释放名额并按新的上限放行排队的请求
+            // dropped 表示请求没有正常完成（连接断开/过载），此时不计延迟样本而是直接收缩
+            void release(int64_t latency_us, bool dropped)
+            {
+                std::vector<Task> ready, expired;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    if (_inflight > 0) --_inflight;
+                    onSample(static_cast<double>(latency_us), dropped);
+                    takeExpired(std::chrono::steady_clock::now(), expired);
+                    while (!_queue.empty() && _inflight < static_cast<int>(_limit))
+                    {
+                        ready.push_back(std::move(_queue.front().task));
+                        _queue.pop_front();
+                        ++_inflight;
+                    }
+                }
+                for (auto &item : expired) item(false);
+                for (auto &item : ready) item(true);
+            }
+            Stats stats()
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                Stats st;
+                st.limit = static_cast<int>(_limit);
+                st.inflight = _inflight;
+                st.queued = _queue.size();
+                st.rejected = _rejected;
+                st.short_rtt_us = _short_rtt;
+                st.long_rtt_us = _long_rtt;
+                return st;
+            }
+
+        private:
+            struct Waiter
+            {
+                Task task;
+                std::chrono::steady_clock::time_point enqueue;
+            };
+            // gradient：gradient = clamp(tolerance * 长期延迟 / 短期延迟, 0.5, 1)
+            // 新上限 = 上限 * gradient + sqrt(上限)，sqrt 项允许少量排队以便发现更多容量；再按 smoothing 平滑
+            void onSample(double rtt, bool dropped)
+            {
+                if (dropped)
+                {
+                    _limit = std::max(_limit * _policy.backoff_ratio, static_cast<double>(_policy.min_limit));
+                    return;
+                }
+                rtt = std::max(rtt, 1.0);
+                _short_rtt = _short_rtt <= 0 ? rtt : _short_rtt * (1 - kShortAlpha) + rtt * kShortAlpha;
+                _long_rtt = _long_rtt <= 0 ? rtt : _long_rtt * (1 - kLongAlpha) + rtt * kLongAlpha;
+                if (_long_rtt > _short_rtt * 2) _long_rtt = _long_rtt * 0.9 + _short_rtt * 0.1;// 对端恢复后基线快速回落，不让旧的高延迟放宽上限
+                double gradient = std::min(1.0, std::max(0.5, _policy.tolerance * _long_rtt / _short_rtt));
+                if (gradient >= 1.0 && _inflight * 2 < _limit) return;// 调用方自身并发不足，不能说明对端还有余量
+                double next = _limit * gradient + std::sqrt(_limit);
+                next = _limit * (1 - _policy.smoothing) + next * _policy.smoothing;
+                _limit = std::min(std::max(next, static_cast<double>(_policy.min_limit)), static_cast<double>(_policy.max_limit));
+            }
+            // 调用方持有锁：取出队首已超时的请求（按入队顺序排列，遇到未超时的即可停止）
+            void takeExpired(std::chrono::steady_clock::time_point now, std::vector<Task> &expired)
+            {
+                auto timeout = std::chrono::milliseconds(_policy.queue_timeout_ms);
+                while (!_queue.empty() && now - _queue.front().enqueue > timeout)
+                {
+                    expired.push_back(std::move(_queue.front().task));
+                    _queue.pop_front();
+                    ++_rejected;
+                }
+            }
+            static constexpr double kShortAlpha = 0.2;  // 短期延迟约为最近 10 个样本
+            static constexpr double kLongAlpha = 0.01;  // 长期基线约为最近几百个样本
+
+            LimiterPolicy _policy;
+            std::mutex _mutex;
+            double _limit;
+            int _inflight = 0;
+            double _short_rtt = 0;
+            double _long_rtt = 0;
+            uint64_t _rejected = 0;
+            std::deque<Waiter> _queue;
+        };
+    }
+}
@@ -31,41 +31,54 @@ namespace lcz_rpc
                 ReqCallback callback;
                 std::promise<BaseMessage::ptr> response;
                 BaseMessage::ptr request;
+                BaseConnection::ptr conn;//请求发往的连接，连接断开时据此让等待中的请求失败
             };
             // 处理服务端响应：匹配请求 id，触发对应的 promise 或回调
             void onResponse(const BaseConnection::ptr& conn,BaseMessage::ptr& msg)
             {
                 std::string id=msg->rid();
-                ReqDescribe::ptr req_desc=getDesc(id);
+                ReqDescribe::ptr req_desc=takeDesc(id);//先摘除再处理，保证与连接断开的失败处理只有一方生效
                 if(req_desc.get()==nullptr)
                 {
                     ELOG("收到 %s 响应，但消息描述不存在",id.c_str());
                     return;
                 }
-                if(req_desc->reqtype==ReqType::ASYNC)
+                complete(req_desc,msg);
+            }
+            // 连接断开：该连接上所有等待中的请求以 CONNECTION_CLOSED 失败，避免调用方永久等待
+            void onClose(const BaseConnection::ptr& conn)
+            {
+                std::vector<ReqDescribe::ptr> pending;
                 {
-                    req_desc->response.set_value(msg);//设置结果
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    for(auto it=_request_desc.begin();it!=_request_desc.end();)
+                    {
+                        if(it->second->conn==conn)
+                        {
+                            pending.push_back(it->second);
+                            it=_request_desc.erase(it);
+                        }
+                        else ++it;
+                    }
                 }
-                else if(req_desc->reqtype==ReqType::CALLBACK)
+                if(!pending.empty())WLOG("连接断开，%zu 个等待中的请求失败",pending.size());
+                for(auto& req_desc:pending)
                 {
-                    if(req_desc->callback)req_desc->callback(msg);//回调处理
+                    complete(req_desc,closedResponse(req_desc->request));
                 }
-                else{
-                    ELOG("未知请求类型");
-                }
-                delDesc(id);//处理完删除掉这个描述信息
             }
             //异步
             bool send(const BaseConnection::ptr& conn,const BaseMessage::ptr& req,AsyncResponse& async_resp)
             {
-                ReqDescribe::ptr req_desc=newDesc(req,ReqType::ASYNC);
+                ReqDescribe::ptr req_desc=newDesc(conn,req,ReqType::ASYNC);
                 if(req_desc.get()==nullptr)
                 {
                     ELOG("构造请求描述对象失败！");
                     return false;
                 }
-                conn->send(req);//异步请求发送
                 async_resp= req_desc->response.get_future();//获取关联的future对象
+                conn->send(req);//异步请求发送
+                checkSent(conn,req);
                 return true;
             }
             //同步
@@ -86,22 +99,81 @@ namespace lcz_rpc
             //回调
             bool send(const BaseConnection::ptr& conn,const BaseMessage::ptr& req,const ReqCallback& cb)
             {
-                ReqDescribe::ptr req_desc=newDesc(req,ReqType::CALLBACK,cb);
+                ReqDescribe::ptr req_desc=newDesc(conn,req,ReqType::CALLBACK,cb);
                 if(req_desc.get()==nullptr)
                 {
                     ELOG("构造请求描述对象失败！");
                     return false;
                 }
                 conn->send(req);
+                checkSent(conn,req);
+                return true;
+            }
+            //批量回调：先登记全部请求描述，再合并成一次写发出，reqs 与 cbs 一一对应
+            bool send(const BaseConnection::ptr& conn,const std::vector<BaseMessage::ptr>& reqs,const std::vector<ReqCallback>& cbs)
+            {
+                if(reqs.size()!=cbs.size())
+                {
+                    ELOG("批量请求与回调数量不一致！");
+                    return false;
+                }
+                for(size_t i=0;i<reqs.size();++i)
+                {
+                    if(newDesc(conn,reqs[i],ReqType::CALLBACK,cbs[i]).get()==nullptr)
+                    {
+                        ELOG("构造请求描述对象失败！");
+                        return false;
+                    }
+                }
+                conn->send(reqs);
+                for(auto& req:reqs)checkSent(conn,req);
                 return true;
             }
             private:
-            ReqDescribe::ptr newDesc(const BaseMessage::ptr& req,ReqType req_type,const ReqCallback& cb=ReqCallback())
+            // 交付响应：future 或回调
+            void complete(const ReqDescribe::ptr& req_desc,const BaseMessage::ptr& msg)
+            {
+                if(req_desc->reqtype==ReqType::ASYNC)
+                {
+                    req_desc->response.set_value(msg);//设置结果
+                }
+                else if(req_desc->reqtype==ReqType::CALLBACK)
+                {
+                    if(req_desc->callback)req_desc->callback(msg);//回调处理
+                }
+                else{
+                    ELOG("未知请求类型");
+                }
+            }
+            // 发送后连接已断开：底层会丢弃数据，这里让请求立即失败（若断开处理已经接管则无事发生）
+            void checkSent(const BaseConnection::ptr& conn,const BaseMessage::ptr& req)
+            {
+                if(conn->connected())return;
+                std::string rid=req->rid();
+                ReqDescribe::ptr req_desc=takeDesc(rid);
+                if(req_desc.get()==nullptr)return;
+                WLOG("请求 %s 发送时连接已断开",rid.c_str());
+                complete(req_desc,closedResponse(req));
+            }
+            // 为请求构造一个 CONNECTION_CLOSED 响应，响应类型与请求类型对应
+            BaseMessage::ptr closedResponse(const BaseMessage::ptr& req)
+            {
+                MsgType resp_type=MsgType::RSP_RPC;
+                if(req->msgType()==MsgType::REQ_TOPIC)resp_type=MsgType::RSP_TOPIC;
+                else if(req->msgType()==MsgType::REQ_SERVICE)resp_type=MsgType::RSP_SERVICE;
+                BaseMessage::ptr msg=MessageFactory::create(resp_type);
+                auto resp=std::dynamic_pointer_cast<JsonResponse>(msg);
+                if(resp.get()!=nullptr)resp->setRcode(RespCode::CONNECTION_CLOSED);
+                msg->setId(req->rid());
+                return msg;
+            }
+            ReqDescribe::ptr newDesc(const BaseConnection::ptr& conn,const BaseMessage::ptr& req,ReqType req_type,const ReqCallback& cb=ReqCallback())
             {
                 std::unique_lock<std::mutex> lock(_mutex);
                 ReqDescribe::ptr req_desc=std::make_shared<ReqDescribe>();
                 req_desc->reqtype=req_type;
                 req_desc->request=req;
+                req_desc->conn=conn;
                 if(req_type==ReqType::CALLBACK&&cb)req_desc->callback=cb;
                 _request_desc[req->rid()]=req_desc;
                 DLOG("newDesc add id=%s", req->rid().c_str());
@@ -122,6 +194,16 @@ namespace lcz_rpc
                 std::unique_lock<std::mutex> lock(_mutex);
                 _request_desc.erase(rid);
             }
+            // 查找并摘除请求描述，同一请求只会被取出一次
+            ReqDescribe::ptr takeDesc(const std::string& rid)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                auto it=_request_desc.find(rid);
+                if(it==_request_desc.end())return ReqDescribe::ptr();
+                ReqDescribe::ptr req_desc=it->second;
+                _request_desc.erase(it);
+                return req_desc;
+            }
             private:
             std::mutex _mutex;
             std::unordered_map<std::string,ReqDescribe::ptr> _request_desc;//rid desc
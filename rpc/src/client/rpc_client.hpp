@@ -2,10 +2,16 @@
 #include <iostream>
 #include "requestor.hpp"
 #include "caller.hpp"
+#include "awaitable.hpp"
+#include "call_policy.hpp"
+#include "limiter.hpp"
 #include "rpc_registry.hpp"
 #include "rpc_topic.hpp"
 #include <string>
+#include <atomic>
+#include <future>
 #include "../general/publicconfig.hpp"
+#include "../general/local.hpp"
 
 namespace lcz_rpc
 {
@@ -32,9 +38,10 @@ namespace lcz_rpc
                     });
                 _client = lcz_rpc::ClientFactory::create(ip, port);
                 _client->setMessageCallback(msg_cb);
+                _client->setCloseCallback(std::bind(&Requestor::onClose, _requestor.get(), std::placeholders::_1));
                 _client->connect();
             }
-            bool methodRegistry(const std::string &method, const HostInfo &host,int load)
+            bool methodRegistry(const std::string &method, const HostInfo &host,int load,int weight = 1,const Locality &locality = Locality())
             {
                 auto conn = _client->connection();
                 if (conn.get() == nullptr || conn->connected() == false)
@@ -42,7 +49,7 @@ namespace lcz_rpc
                     ELOG("连接获取失败,无法注册服务:%s", method.c_str());
                     return false;
                 }
-                return _provider->methodRegistry(conn, method, host, load);
+                return _provider->methodRegistry(conn, method, host, load, weight, locality);
             }
             //给外部提供上报负载的接口
             bool reportLoad(const std::string &method, const HostInfo &host,int load)
@@ -95,6 +102,7 @@ namespace lcz_rpc
                 _dispacher->registerhandler<ServiceRequest>(lcz_rpc::MsgType::REQ_SERVICE, req_cb);
                 _client = lcz_rpc::ClientFactory::create(ip, port);
                 _client->setMessageCallback(msg_cb);
+                _client->setCloseCallback(std::bind(&Requestor::onClose, _requestor.get(), std::placeholders::_1));
                 _client->connect();
                 // 启动健康检查线程，定期刷新已发现服务
                 _health_loop_ptr = _health_loop.startLoop();
@@ -112,19 +120,25 @@ namespace lcz_rpc
                         return;
                     }
 
-                    for (const auto& method : methods) {
-                        HostDetail detail;
-                        if (_discover->serviceDiscover(conn, method, detail, LoadBalanceStrategy::ROUND_ROBIN, true)) {
-                            DLOG("[ClientDiscover-健康检查] method=%s 刷新成功 host=%s:%d load=%d",
-                                 method.c_str(), detail.host.first.c_str(), detail.host.second, detail.load);
-                        } else {
-                            WLOG("[ClientDiscover-健康检查] method=%s 刷新失败，等待下次调用重新发现", method.c_str());
+                    // 批量刷新：每 kRefreshBatch 个方法一次请求，结果原地合并进已有的 MethodHost
+                    for (size_t begin = 0; begin < methods.size(); begin += kRefreshBatch) {
+                        std::vector<std::string> batch(methods.begin() + begin,
+                                                       methods.begin() + std::min(methods.size(), begin + kRefreshBatch));
+                        auto found = _discover->serviceDiscoverBatch(conn, batch);
+                        DLOG("[ClientDiscover-健康检查] 批量刷新 %zu 个方法，%zu 个有提供者", batch.size(), found.size());
+                        if (found.size() == batch.size()) continue;
+                        std::unordered_set<std::string> found_set(found.begin(), found.end());
+                        for (const auto& method : batch) {
+                            if (!found_set.count(method))
+                                WLOG("[ClientDiscover-健康检查] method=%s 刷新失败，等待下次调用重新发现", method.c_str());
                         }
                     }
                 });
             }
 
-            bool serviceDiscover(const std::string &method, HostDetail &detail_bylast/*上一个serviceDiscover传入的detail*/,LoadBalanceStrategy strategy) {
+            //exclude 非空时挑选除它之外的主机（对冲/重试换主机）；hash_key 供 SOURCE_HASH 使用
+            bool serviceDiscover(const std::string &method, HostDetail &detail_bylast/*上一个serviceDiscover传入的detail*/,LoadBalanceStrategy strategy,
+                                 const HostInfo &exclude = HostInfo(), const std::string &hash_key = std::string()) {
                 HostDetail detail;
                 auto conn = _client->connection();
                 if(conn.get() == nullptr || conn->connected() == false)
@@ -132,7 +146,7 @@ namespace lcz_rpc
                     ELOG("连接获取失败,无法发现服务:%s", method.c_str());
                     return false;
                 }
-                if (_discover->serviceDiscover(conn, method, detail,strategy)) {
+                if (_discover->serviceDiscover(conn, method, detail,strategy,false,exclude,hash_key)) {
                     detail_bylast = detail;
                     {
                         std::unique_lock<std::mutex> lock(_tracked_mutex);
@@ -161,7 +175,35 @@ namespace lcz_rpc
                 }
                 return false;  // 别忘记有返回
             }
+            //批量发现：一次请求发现多个方法并开始跟踪刷新，返回有提供者的方法
+            std::vector<std::string> serviceDiscover(const std::vector<std::string> &methods)
+            {
+                auto conn = _client->connection();
+                if(conn.get() == nullptr || conn->connected() == false)
+                {
+                    ELOG("连接获取失败,无法批量发现服务");
+                    return std::vector<std::string>();
+                }
+                auto found = _discover->serviceDiscoverBatch(conn, methods);
+                {
+                    std::unique_lock<std::mutex> lock(_tracked_mutex);
+                    _tracked_methods.insert(found.begin(), found.end());
+                }
+                return found;
+            }
+            void setHealthPolicy(const HealthPolicy &policy) { _discover->setHealthPolicy(policy); }
+            void setLocality(const Locality &self, const LocalityPolicy &policy) { _discover->setLocality(self, policy); }
+            void setUpdateCallback(const Discover::UpdateCallback &cb) { _discover->setUpdateCallback(cb); }
+            //已缓存的方法主机列表，不触发远程发现
+            MethodHost::ptr methodHost(const std::string &method) { return _discover->findMethod(method); }
+            //请求发出/完成反馈，驱动按主机的被动健康检查和 P2C_LATENCY 策略
+            void onSend(const std::string &method, const HostInfo &host) { _discover->onSend(method, host); }
+            void onResult(const std::string &method, const HostInfo &host, RespCode rcode, int64_t latency_us)
+            {
+                _discover->onResult(method, host, rcode, latency_us);
+            }
         private:
+            static constexpr size_t kRefreshBatch = 128;//单次批量刷新的方法数上限，避免单条消息过大
             BaseClient::ptr _client;
             Requestor::ptr _requestor;
             Discover::ptr _discover;
@@ -182,6 +224,7 @@ namespace lcz_rpc
             // enablediscover 是否开启服务发现
             RpcClient(bool enablediscover, const std::string &ip, int port)
                 : _enablediscover(enablediscover),
+                  _rpc_host(ip, port),
                   _requestor(std::make_shared<Requestor>()),
                   _caller(std::make_shared<RpcCaller>(_requestor)),
                   _dispacher(std::make_shared<Dispacher>()),
@@ -194,13 +237,16 @@ namespace lcz_rpc
                 {
                     auto offlinecb = std::bind(&RpcClient::delClient, this, std::placeholders::_1);
                     _discover_client = std::make_shared<ClientDiscover>(ip, port, offlinecb); // 设置服务下线删除长连接
+                    _discover_client->setUpdateCallback(std::bind(&RpcClient::invalidateRoute, this, std::placeholders::_1)); // 主机列表变化时路由失效
                 }
                 else
                 {
                     auto msg_cb = std::bind(&Dispacher::onMessage, _dispacher.get(), std::placeholders::_1, std::placeholders::_2);
                     _rpc_client = lcz_rpc::ClientFactory::create(ip, port);
                     _rpc_client->setMessageCallback(msg_cb);
+                    _rpc_client->setCloseCallback(std::bind(&Requestor::onClose, _requestor.get(), std::placeholders::_1));
                     _rpc_client->connect();
+                    _caller->handshake(_rpc_client->connection());
                 }
 
             }
@@ -208,42 +254,946 @@ namespace lcz_rpc
             {
                 _loadbalance_strategy = strategy;
             }
-            bool call(const std::string &method_name, const Json::Value &params, Json::Value &result)
+            // 回调模式（call/callBatch 传入回调）的完成执行器，需在发起调用前设置
+            // 为空时回调直接在 I/O 线程上执行；使用线程池时，同一 I/O 线程上完成的回调（即同一连接上的响应）按到达顺序执行
+            void setCallbackExecutor(const Executor::ptr &executor)
             {
-                BaseClient::ptr client = getClient(method_name);
-                if (client.get() == nullptr)
+                _callback_executor = executor;
+            }
+            // 进程内短路（默认开启）：选中的提供者就是本进程里的 RpcServer 时，直接在其路由器上执行，不序列化、不走网络
+            // executor 为空时在调用线程上执行服务，否则投递到 executor；服务端设置为 POOLED 的方法总是在服务端工作线程池上执行
+            // 回调模式下回调不会在 call 返回前执行：服务同步完成时回调改到回调执行器或定时器线程上；需在发起调用前设置
+            // 本地调用不经过并发限制，也不计入健康检查
+            void setLocalCall(bool enable, const Executor::ptr &executor = Executor::ptr())
+            {
+                _local_executor = executor;
+                _local_enabled.store(enable, std::memory_order_release);
+                clearRoutes();// 路由中记录的本地端点随开关失效
+            }
+            // 被动健康检查配置：连续失败/错误率/延迟超过阈值的提供者被临时摘除，到期后放行探测请求
+            // 仅在开启服务发现时生效，默认开启
+            void setHealthPolicy(const HealthPolicy &policy)
+            {
+                if (!_enablediscover) return;
+                _discover_client->setHealthPolicy(policy);
+                clearRoutes();//路由缓存的快照里带着旧配置
+            }
+            // 就近路由：声明客户端自身的 zone/rack/node，优先选同机、同机架、同可用区的提供者
+            // 最近一层的可用主机数、可用占比或平均负载不满足 policy 时溢出到下一层；层内仍按原有负载均衡策略挑选
+            // 仅在开启服务发现时生效，传入空的 Locality 关闭
+            void setLocality(const Locality &self, const LocalityPolicy &policy = LocalityPolicy())
+            {
+                if (!_enablediscover) return;
+                _discover_client->setLocality(self, policy);
+                clearRoutes();
+            }
+            // 为幂等方法开启对冲：delay 内未收到响应就向另一台提供者再发一份，先到的响应生效，后到的忽略
+            // 仅在开启服务发现时生效；对冲请求数受 budget_ratio 限制
+            void setHedgePolicy(const std::string &method, const HedgePolicy &policy)
+            {
+                updatePolicies(method, [&policy](MethodPolicies &policies) { policies.hedge = std::make_shared<HedgeState>(policy); });
+            }
+            HedgeState::Stats hedgeStats(const std::string &method)
+            {
+                MethodPolicies::ptr policies = methodPolicies(method);
+                return policies && policies->hedge ? policies->hedge->stats() : HedgeState::Stats();
+            }
+            // 开启按主机的自适应并发限制：每台提供者的在途请求数不超过随延迟调整的上限，超出的请求短暂排队
+            // 队列满或排队超时的请求以 OVERLOADED 失败（开启重试的方法会换一台提供者重试）；重新设置会重置全部主机的状态
+            void setConcurrencyLimit(const LimiterPolicy &policy)
+            {
+                std::unique_lock<std::mutex> lock(_limiter_mutex);
+                _limiter_policy = std::make_shared<const LimiterPolicy>(policy);
+                _limiters.store(std::make_shared<LimiterMap>());
+                _limiter_enabled.store(true, std::memory_order_release);
+                clearRoutes();// 路由缓存着各主机的限制器
+            }
+            ConcurrencyLimiter::Stats limiterStats(const HostInfo &host)
+            {
+                auto limiters = _limiters.load();
+                auto it = limiters->find(host);
+                return it == limiters->end() ? ConcurrencyLimiter::Stats() : it->second->stats();
+            }
+            // 全部主机的并发限制状态（当前上限、在途数、排队数等）
+            std::vector<std::pair<HostInfo, ConcurrencyLimiter::Stats>> limiterStats()
+            {
+                std::vector<std::pair<HostInfo, ConcurrencyLimiter::Stats>> ret;
+                for (auto &item : *_limiters.load()) ret.emplace_back(item.first, item.second->stats());
+                return ret;
+            }
+            // 为幂等方法开启重试：连接断开或 INTERNAL_ERROR 时退避后重发，默认换一台提供者
+            // 重试次数受 budget_ratio 限制，提供者整体过载时不会把流量放大数倍
+            void setRetryPolicy(const std::string &method, const RetryPolicy &policy)
+            {
+                updatePolicies(method, [&policy](MethodPolicies &policies) { policies.retry = std::make_shared<RetryState>(policy); });
+            }
+            RetryState::Stats retryStats(const std::string &method)
+            {
+                MethodPolicies::ptr policies = methodPolicies(method);
+                return policies && policies->retry ? policies->retry->stats() : RetryState::Stats();
+            }
+            // 为幂等方法开启相同请求合并：同一方法、相同参数（及 hash_key）的请求在途时，后来的调用不再发出，共享该请求的结果
+            // 适合缓存回填等多个线程同时请求同一数据的场景；enable=false 关闭
+            void setCoalesce(const std::string &method, bool enable = true)
+            {
+                updatePolicies(method, [enable](MethodPolicies &policies) {
+                    if (!enable) policies.coalesce.reset();
+                    else if (policies.coalesce.get() == nullptr) policies.coalesce = std::make_shared<CoalesceState>();
+                });
+            }
+            CoalesceState::Stats coalesceStats(const std::string &method)
+            {
+                MethodPolicies::ptr policies = methodPolicies(method);
+                return policies && policies->coalesce ? policies->coalesce->stats() : CoalesceState::Stats();
+            }
+            // 为结果很少变化的幂等查询方法开启客户端响应缓存：相同参数在 ttl 内直接返回上次的成功结果，不发请求
+            // 重新设置会清空该方法的缓存；只缓存 SUCCESS 响应
+            void setCachePolicy(const std::string &method, const CachePolicy &policy)
+            {
+                updatePolicies(method, [&policy](MethodPolicies &policies) { policies.cache = std::make_shared<ResponseCache>(policy); });
+            }
+            void removeCachePolicy(const std::string &method)
+            {
+                updatePolicies(method, [](MethodPolicies &policies) { policies.cache.reset(); });
+            }
+            ResponseCache::Stats cacheStats(const std::string &method)
+            {
+                MethodPolicies::ptr policies = methodPolicies(method);
+                return policies && policies->cache ? policies->cache->stats() : ResponseCache::Stats();
+            }
+            // 启动预热：一次请求批量发现 methods，并行建立到全部提供者的连接，再建好路由表
+            // probe 为 true 时向每条连接发一个内置空操作请求（METHOD_PING）并等待应答，让首个业务请求走的就是稳态路径
+            // 全部方法都找到提供者且连接（和探测）全部成功时返回 true；失败的部分在首次调用时仍会按需处理
+            bool warmup(const std::vector<std::string> &methods, bool probe = false)
+            {
+                if (delayedPoliciesInUse()) timerLoop();// 对冲/重试依赖的定时器线程也提前创建
+                std::vector<BaseClient::ptr> clients;
+                bool ok = true;
+                if (!_enablediscover)
                 {
-                    ELOG("服务获取失败：%s", method_name.c_str());
-                    return false;
+                    clients.push_back(_rpc_client);
                 }
-                return _caller->call(client->connection(), method_name, params, result);
+                else
+                {
+                    auto found = _discover_client->serviceDiscover(methods);
+                    if (found.size() != methods.size())
+                    {
+                        WLOG("预热：%zu 个方法中只有 %zu 个找到提供者", methods.size(), found.size());
+                        ok = false;
+                    }
+                    std::vector<HostInfo> hosts;
+                    for (const auto &method : found)
+                    {
+                        MethodHost::ptr method_host = _discover_client->methodHost(method);
+                        if (method_host.get() == nullptr) continue;
+                        for (const auto &detail : method_host->snapshot()->hosts)
+                        {
+                            if (localEndpoint(detail.host).get() != nullptr) continue;// 本进程的提供者不需要连接
+                            if (std::find(hosts.begin(), hosts.end(), detail.host) == hosts.end()) hosts.push_back(detail.host);
+                        }
+                    }
+                    // connect 会阻塞到连接建立（每条连接还要起一个 I/O 线程），逐台串行建立时总耗时随提供者数线性增长
+                    std::vector<std::future<BaseClient::ptr>> pending;
+                    for (const auto &host : hosts)
+                    {
+                        pending.push_back(std::async(std::launch::async, [this, host] { return getClient(host); }));
+                    }
+                    for (auto &item : pending) clients.push_back(item.get());
+                    for (const auto &method : found) buildRoute(method);
+                }
+                size_t connected = 0;
+                for (const auto &client : clients)
+                {
+                    if (client.get() != nullptr && client->connected()) ++connected;
+                }
+                if (connected != clients.size())
+                {
+                    WLOG("预热：%zu 条连接中 %zu 条建立成功", clients.size(), connected);
+                    ok = false;
+                }
+                if (probe) ok = probeClients(clients) && ok;
+                ILOG("预热完成：方法=%zu 连接=%zu/%zu", methods.size(), connected, clients.size());
+                return ok;
             }
-            bool call(const std::string &method_name, Json::Value &params, RpcCaller::RpcAsyncRespose &result)
+            // hash_key 非空且策略为 SOURCE_HASH 时，同一 key 的请求固定发往同一提供者（一致性哈希，提供者增减只影响少量 key）
+            bool call(const std::string &method_name, const Json::Value &params, Json::Value &result,
+                      const std::string &hash_key = std::string())
             {
-                BaseClient::ptr client = getClient(method_name);
-                if (client.get() == nullptr)
+                Promise<Json::Value> promise;
+                auto future = promise.future();
+                RespCode failure = RespCode::SERVICE_NOT_FOUND;
+                if (!invoke(method_name, params, hash_key, fulfill(promise), &failure))
+                {
+                    ELOG("rpc请求未发出：%s", errReason(failure).c_str());
+                    return false;
+                }
+                if (!future.ok())
                 {
-                    ELOG("服务获取失败：%s", method_name.c_str());
+                    ELOG("rpc请求出错：%s", errReason(future.rcode()).c_str());
                     return false;
                 }
-                return _caller->call(client->connection(), method_name, params, result);
+                result = future.get();
+                return true;
             }
-            bool call(const std::string &method_name, Json::Value &params, const RpcCaller::ResponseCallback &cb)
+            bool call(const std::string &method_name, Json::Value &params, RpcCaller::RpcAsyncRespose &result,
+                      const std::string &hash_key = std::string())
             {
-                BaseClient::ptr client = getClient(method_name);
-                if (client.get() == nullptr)
+                Promise<Json::Value> promise;
+                result = promise.future();
+                RespCode failure = RespCode::SERVICE_NOT_FOUND;
+                if (!invoke(method_name, params, hash_key, fulfill(promise), &failure))
                 {
-                    ELOG("服务获取失败：%s", method_name.c_str());
+                    promise.setError(failure);// 返回已失败的 future，避免调用方等待一个永远不会完成的 future
                     return false;
                 }
-                return _caller->call(client->connection(), method_name, params, cb);
+                return true;
+            }
+            bool call(const std::string &method_name, Json::Value &params, const RpcCaller::ResponseCallback &cb,
+                      const std::string &hash_key = std::string())
+            {
+                auto executor = _callback_executor;
+                auto returned = std::make_shared<std::atomic<bool>>(false);// invoke 是否已返回
+                bool ret = invoke(method_name, params, hash_key, [this, cb, executor, returned](RespCode rcode, const Json::Value &result) {
+                    if (rcode != RespCode::SUCCESS)
+                    {
+                        ELOG("rpc回调出错：%s", errReason(rcode).c_str());
+                        return;
+                    }
+                    if (executor)
+                    {
+                        executor->post(completionKey(), [cb, result] { cb(result); });
+                        return;
+                    }
+                    // 进程内短路时服务可能在 call 返回前就同步完成，此时改到定时器线程上回调，与走网络时一样晚于 call 返回
+                    if (!returned->load(std::memory_order_acquire)) timerLoop()->queueInLoop([cb, result] { cb(result); });
+                    else cb(result);
+                });
+                returned->store(true, std::memory_order_release);
+                return ret;
+            }
+#ifdef LCZ_RPC_HAS_COROUTINE
+            // 协程调用：co_await client.async_call(method, params) 得到 RpcResult，失败时 rcode 非 SUCCESS
+            // executor 为空时协程在响应所在的 I/O 线程上恢复，耗时的后续逻辑应传入执行器
+            RpcAwaitable async_call(const std::string &method_name, const Json::Value &params,
+                                    RpcAwaitable::ResumeExecutor executor = nullptr, const std::string &hash_key = std::string())
+            {
+                auto launcher = [this, method_name, params, hash_key](const RpcCaller::StatusCallback &cb) {
+                    RespCode failure = RespCode::SERVICE_NOT_FOUND;
+                    if (invoke(method_name, params, hash_key, cb, &failure)) return true;
+                    cb(failure, Json::Value());// 请求未发出时直接以实际原因完成，协程不挂起
+                    return true;
+                };
+                return RpcAwaitable(launcher, std::move(executor));
+            }
+#endif
+            // 批量调用：按目标提供者分组，每组合并成一次写；全部响应到达后触发一次 cb
+            // cb 总会被触发恰好一次（无法发送的请求以错误码回报），返回 false 表示没有任何请求被发出
+            bool callBatch(const RpcCaller::BatchRequest &calls, const RpcCaller::BatchCallback &cb)
+            {
+                struct BatchState
+                {
+                    std::vector<RpcCaller::BatchReply> replies;
+                    std::atomic<size_t> remaining{0};
+                    RpcCaller::BatchCallback cb;
+                };
+                auto state = std::make_shared<BatchState>();
+                state->replies.resize(calls.size());
+                state->remaining = calls.size();
+                state->cb = cb;
+                auto executor = _callback_executor;
+                if (executor)
+                {
+                    state->cb = [cb, executor](std::vector<RpcCaller::BatchReply> &replies) {
+                        auto moved = std::make_shared<std::vector<RpcCaller::BatchReply>>(std::move(replies));
+                        executor->post(completionKey(), [cb, moved] { cb(*moved); });
+                    };
+                }
+                if (calls.empty())
+                {
+                    state->cb(state->replies);
+                    return true;
+                }
+                auto on_reply = [state](size_t idx, RespCode rcode, const Json::Value &result) {
+                    state->replies[idx].rcode = rcode;
+                    state->replies[idx].result = result;
+                    if (state->remaining.fetch_sub(1) == 1) state->cb(state->replies);// 最后一个响应触发完成回调
+                };
+                return dispatchBatch(calls, on_reply);
+            }
+            // 批量调用（future 版本）：results[i] 对应 calls[i]，失败的请求以错误码完成，可用 whenAll 汇总
+            bool callBatch(const RpcCaller::BatchRequest &calls, std::vector<RpcCaller::RpcAsyncRespose> &results)
+            {
+                auto promises = std::make_shared<std::vector<Promise<Json::Value>>>(calls.size());
+                results.clear();
+                results.reserve(calls.size());
+                for (auto &promise : *promises) results.emplace_back(promise.future());
+                auto on_reply = [promises](size_t idx, RespCode rcode, const Json::Value &result) {
+                    if (rcode == RespCode::SUCCESS) (*promises)[idx].setValue(result);
+                    else (*promises)[idx].setError(rcode);
+                };
+                return dispatchBatch(calls, on_reply);
             }
 
         private:
+            // 方法级调用策略：对冲/重试/合并/缓存，一次查找全部取到；设置时复制一份修改后整体替换
+            struct MethodPolicies
+            {
+                using ptr = std::shared_ptr<const MethodPolicies>;
+                HedgeState::ptr hedge;
+                RetryState::ptr retry;
+                CoalesceState::ptr coalesce;
+                ResponseCache::ptr cache;
+            };
+            using PolicyTable = std::unordered_map<std::string, MethodPolicies::ptr>;
+            // 按方法解析好的路由：主机快照 + 与之一一对应的连接和限制器，再加上该方法的调用策略
+            // 稳态调用只读一次路由表快照，之后的选择、限流与结果反馈都在路由持有的对象上做原子操作；上下线/刷新/改配置时失效
+            struct Route
+            {
+                MethodHost::ptr method_host;
+                MethodHost::Snapshot snapshot;
+                std::vector<BaseClient::ptr> clients;// 与 snapshot->hosts 一一对应，尚未建立连接的为空
+                std::vector<std::weak_ptr<LocalEndpoint>> locals;// 与 snapshot->hosts 一一对应的本进程端点，没有本进程提供者时为空
+                std::vector<ConcurrencyLimiter::ptr> limiters;// 与 snapshot->hosts 一一对应，未开启并发限制时为空
+                MethodPolicies::ptr policies;// 没有配置任何策略时为空
+            };
+            using RoutePtr = std::shared_ptr<const Route>;
+            // 一次发送选中的提供者：命中路由时带上路由和主机下标，结果反馈直接更新主机状态
+            struct Target
+            {
+                HostInfo host;
+                LocalEndpoint::ptr local;// 选中本进程的提供者时非空
+                RoutePtr route;// 未命中路由（慢路径/未开启服务发现）时为空
+                size_t pos = 0;
+            };
+            // 回调执行器的顺序键：完成回调所在的线程，同一连接的响应都在同一 I/O 线程上完成
+            static size_t completionKey()
+            {
+                return std::hash<std::thread::id>()(std::this_thread::get_id());
+            }
+            static RpcCaller::StatusCallback fulfill(const Promise<Json::Value> &promise)
+            {
+                return [promise](RespCode rcode, const Json::Value &result) {
+                    if (rcode == RespCode::SUCCESS) promise.setValue(result);
+                    else promise.setError(rcode);
+                };
+            }
+            // 统一调用内核：各种调用方式最终都走这里，按方法策略决定发送方式
+            // 开启服务发现且路由已建立时，策略从路由中取，整个调用只读一次路由表快照
+            // 返回 false 表示请求没有发出，此时 done 不会被触发，failure 非空时写入失败原因
+            // （SERVICE_NOT_FOUND：没有可用的提供者；CONNECTION_CLOSED：选中的提供者连接不可用）
+            bool invoke(const std::string &method, const Json::Value &params, const std::string &hash_key,
+                        const RpcCaller::StatusCallback &done, RespCode *failure = nullptr)
+            {
+                RoutePtr route = findRoute(method);
+                MethodPolicies::ptr policies = route ? route->policies : methodPolicies(method);
+                if (policies.get() == nullptr) return sendTo(method, params, hash_key, done, HostInfo(), nullptr, route, failure);
+                const ResponseCache::ptr &cache = policies->cache;
+                const CoalesceState::ptr &coalesce = policies->coalesce;
+                if (cache.get() == nullptr && coalesce.get() == nullptr) return invokeDirect(*policies, route, method, params, hash_key, done, failure);
+                std::string key = RequestKey::make(params, hash_key);//缓存与合并共用同一个键，只序列化一次
+                RpcCaller::StatusCallback on_done = done;
+                if (cache.get() != nullptr)
+                {
+                    Json::Value cached;
+                    if (cache->get(key, cached))
+                    {
+                        done(RespCode::SUCCESS, cached);
+                        return true;
+                    }
+                    on_done = [cache, key, done](RespCode rcode, const Json::Value &result) {
+                        if (rcode == RespCode::SUCCESS) cache->put(key, result);
+                        done(rcode, result);
+                    };
+                }
+                if (coalesce.get() != nullptr) return invokeCoalesced(*policies, route, key, method, params, hash_key, on_done, failure);
+                return invokeDirect(*policies, route, method, params, hash_key, on_done, failure);
+            }
+            // 合并调用：相同请求在途时挂到其完成回调上；否则发出请求，完成后把结果分发给期间挂上的全部调用
+            bool invokeCoalesced(const MethodPolicies &policies, const RoutePtr &route, const std::string &key, const std::string &method,
+                                 const Json::Value &params, const std::string &hash_key, const RpcCaller::StatusCallback &done,
+                                 RespCode *failure)
+            {
+                CoalesceState::ptr coalesce = policies.coalesce;
+                if (!coalesce->join(key, done)) return true;
+                auto fanout = [coalesce, key](RespCode rcode, const Json::Value &result) {
+                    for (auto &cb : coalesce->finish(key)) cb(rcode, result);
+                };
+                RespCode rcode = RespCode::SERVICE_NOT_FOUND;
+                if (invokeDirect(policies, route, method, params, hash_key, fanout, &rcode)) return true;
+                // 请求没有发出：发起者按约定不触发 done，期间挂上的调用以同一失败原因完成
+                auto waiters = coalesce->finish(key);
+                for (size_t i = 1; i < waiters.size(); ++i) waiters[i](rcode, Json::Value());
+                if (failure) *failure = rcode;
+                return false;
+            }
+            bool invokeDirect(const MethodPolicies &policies, const RoutePtr &route, const std::string &method, const Json::Value &params,
+                              const std::string &hash_key, const RpcCaller::StatusCallback &done, RespCode *failure)
+            {
+                if (policies.retry.get() != nullptr) return invokeRetry(policies.retry, policies.hedge, route, method, params, hash_key, done);
+                return attempt(policies.hedge, route, method, params, hash_key, done, HostInfo(), nullptr, failure);
+            }
+            // 单次尝试：按对冲配置决定是否对冲；route 为空时重新查找路由
+            bool attempt(const HedgeState::ptr &hedge, const RoutePtr &route, const std::string &method, const Json::Value &params,
+                         const std::string &hash_key, const RpcCaller::StatusCallback &done,
+                         const HostInfo &exclude = HostInfo(), HostInfo *chosen = nullptr, RespCode *failure = nullptr)
+            {
+                if (hedge.get() != nullptr && _enablediscover)
+                    return invokeHedged(hedge, route, method, params, hash_key, done, exclude, chosen, failure);
+                return sendTo(method, params, hash_key, done, exclude, chosen, route, failure);
+            }
+            struct RetryCall
+            {
+                std::string method;
+                Json::Value params;
+                std::string hash_key;
+                RpcCaller::StatusCallback done;
+                HedgeState::ptr hedge;// 每次尝试沿用发起时的对冲配置
+                int attempts = 1;   // 当前是第几次尝试
+                std::mutex mutex;   // 保护 last_host：发送方写入与响应触发的下一次尝试可能在不同线程
+                HostInfo last_host; // 上一次尝试的主机
+            };
+            // 重试调用：可重试的失败在退避后重新发起，直到成功、不可重试、次数用尽或预算不足
+            // 某次尝试未能发出时以其失败原因交给重试判断，因此总是返回 true，结果一定经由 done 回报
+            bool invokeRetry(const RetryState::ptr &retry, const HedgeState::ptr &hedge, const RoutePtr &route, const std::string &method,
+                             const Json::Value &params, const std::string &hash_key, const RpcCaller::StatusCallback &done)
+            {
+                auto call = std::make_shared<RetryCall>();
+                call->method = method;
+                call->params = params;
+                call->hash_key = hash_key;
+                call->done = done;
+                call->hedge = hedge;
+                retry->onRequest();
+                retryAttempt(retry, call, route);
+                return true;
+            }
+            // 首次尝试沿用调用方查到的路由，退避后的重试重新查找（期间主机列表可能已经变化）
+            void retryAttempt(const RetryState::ptr &retry, const std::shared_ptr<RetryCall> &call, const RoutePtr &route = RoutePtr())
+            {
+                auto on_done = [this, retry, call](RespCode rcode, const Json::Value &result) {
+                    if (rcode == RespCode::SUCCESS || !RetryState::retryable(rcode) || !scheduleRetry(retry, call))
+                    {
+                        call->done(rcode, result);
+                        return;
+                    }
+                    DLOG("method=%s 第 %d 次尝试失败(%s)，准备重试", call->method.c_str(), call->attempts - 1, errReason(rcode).c_str());
+                };
+                HostInfo exclude;
+                if (retry->policy().switch_host)
+                {
+                    std::unique_lock<std::mutex> lock(call->mutex);
+                    exclude = call->last_host;
+                }
+                HostInfo chosen;
+                RespCode failure = RespCode::SERVICE_NOT_FOUND;
+                bool sent = attempt(call->hedge, route, call->method, call->params, call->hash_key, on_done, exclude, &chosen, &failure);
+                if (!sent && !exclude.first.empty())// 没有其他主机时回到原主机
+                    sent = attempt(call->hedge, route, call->method, call->params, call->hash_key, on_done, HostInfo(), &chosen, &failure);
+                if (sent)
+                {
+                    std::unique_lock<std::mutex> lock(call->mutex);
+                    call->last_host = chosen;
+                    return;
+                }
+                on_done(failure, Json::Value());
+            }
+            // 在定时器线程上延后发起下一次尝试，不阻塞 I/O 线程
+            bool scheduleRetry(const RetryState::ptr &retry, const std::shared_ptr<RetryCall> &call)
+            {
+                int next = call->attempts + 1;
+                if (!retry->tryRetry(next)) return false;
+                call->attempts = next;
+                double delay_sec = static_cast<double>(retry->backoffMs(next)) / 1000.0;
+                timerLoop()->runAfter(delay_sec, [this, retry, call]() { retryAttempt(retry, call); });
+                return true;
+            }
+            // 选出提供者并发送一次；exclude 非空时避开该主机，chosen 返回实际选中的主机；route 为空时重新查找路由
+            // 未能发出时返回 false，failure 非空时写入原因：没有可用提供者为 SERVICE_NOT_FOUND，连接不可用为 CONNECTION_CLOSED
+            bool sendTo(const std::string &method, const Json::Value &params, const std::string &hash_key,
+                        const RpcCaller::StatusCallback &done, const HostInfo &exclude = HostInfo(), HostInfo *chosen = nullptr,
+                        const RoutePtr &route = RoutePtr(), RespCode *failure = nullptr)
+            {
+                Target target;
+                BaseClient::ptr client = getClient(method, hash_key, exclude, target, route);
+                if (target.local.get() != nullptr)
+                {
+                    if (chosen) *chosen = target.host;
+                    return dispatchLocal(target.local, method, params, done);
+                }
+                if (client.get() == nullptr)
+                {
+                    ELOG("服务获取失败：%s", method.c_str());
+                    if (failure) *failure = RespCode::SERVICE_NOT_FOUND;
+                    return false;
+                }
+                auto conn = client->connection();
+                if (conn.get() == nullptr)
+                {
+                    ELOG("连接不可用：%s", method.c_str());
+                    if (_enablediscover) _discover_client->onResult(method, target.host, RespCode::CONNECTION_CLOSED, 0);
+                    if (failure) *failure = RespCode::CONNECTION_CLOSED;
+                    return false;
+                }
+                if (chosen) *chosen = target.host;
+                ConcurrencyLimiter::ptr limiter = target.route && !target.route->limiters.empty() ? target.route->limiters[target.pos]
+                                                                                                  : hostLimiter(target.host);
+                if (limiter.get() == nullptr)
+                {
+                    if (dispatch(method, params, target, conn, done)) return true;
+                    if (failure) *failure = RespCode::CONNECTION_CLOSED;
+                    return false;
+                }
+                // 名额可能在之后其他请求完成时才放行，此时由放行方的线程发送；未能发出的请求以错误码经 done 回报
+                limiter->submit([this, limiter, method, params, target, conn, done](bool admitted) {
+                    if (!admitted)
+                    {
+                        done(RespCode::OVERLOADED, Json::Value());
+                        return;
+                    }
+                    auto start = std::chrono::steady_clock::now();
+                    auto on_done = [limiter, start, done](RespCode rcode, const Json::Value &result) {
+                        auto cost = std::chrono::steady_clock::now() - start;
+                        bool dropped = rcode == RespCode::CONNECTION_CLOSED || rcode == RespCode::OVERLOADED;
+                        limiter->release(std::chrono::duration_cast<std::chrono::microseconds>(cost).count(), dropped);
+                        done(rcode, result);
+                    };
+                    if (!dispatch(method, params, target, conn, on_done))
+                    {
+                        limiter->release(0, true);
+                        done(RespCode::CONNECTION_CLOSED, Json::Value());
+                    }
+                });
+                return true;
+            }
+            // 在选定的连接上发出请求；命中路由时直接更新路由快照里的主机状态，否则按方法名和主机查找
+            bool dispatch(const std::string &method, const Json::Value &params, const Target &target,
+                          const BaseConnection::ptr &conn, const RpcCaller::StatusCallback &done)
+            {
+                if (!_enablediscover) return _caller->call(conn, method, params, done);
+                if (target.route.get() == nullptr) return dispatch(method, params, target.host, conn, done);
+                RoutePtr route = target.route;
+                size_t pos = target.pos;
+                auto start = std::chrono::steady_clock::now();
+                MethodHost::onSend(*route->snapshot, pos);
+                bool ret = _caller->call(conn, method, params, [route, pos, start, done](RespCode rcode, const Json::Value &result) {
+                    auto cost = std::chrono::steady_clock::now() - start;
+                    route->method_host->onResult(*route->snapshot, pos, MethodHost::healthyResponse(rcode),
+                                                 std::chrono::duration_cast<std::chrono::microseconds>(cost).count());
+                    done(rcode, result);
+                });
+                if (!ret) route->method_host->onResult(*route->snapshot, pos, false, 0);
+                return ret;
+            }
+            bool dispatch(const std::string &method, const Json::Value &params, const HostInfo &host,
+                          const BaseConnection::ptr &conn, const RpcCaller::StatusCallback &done)
+            {
+                if (!_enablediscover) return _caller->call(conn, method, params, done);
+                // 记录在途数、耗时与结果，反馈给健康检查和 P2C_LATENCY
+                auto discover = _discover_client;
+                auto start = std::chrono::steady_clock::now();
+                discover->onSend(method, host);
+                bool ret = _caller->call(conn, method, params, [discover, method, host, start, done](RespCode rcode, const Json::Value &result) {
+                    auto cost = std::chrono::steady_clock::now() - start;
+                    discover->onResult(method, host, rcode, std::chrono::duration_cast<std::chrono::microseconds>(cost).count());
+                    done(rcode, result);
+                });
+                if (!ret) discover->onResult(method, host, RespCode::CONNECTION_CLOSED, 0);
+                return ret;
+            }
+            // 进程内调用：params 直接交给本进程的路由器，不做序列化
+            bool dispatchLocal(const LocalEndpoint::ptr &local, const std::string &method, const Json::Value &params,
+                               const RpcCaller::StatusCallback &done)
+            {
+                Executor::ptr executor = _local_executor;
+                if (executor.get() == nullptr)
+                {
+                    local->invoke(method, params, done);
+                    return true;
+                }
+                executor->post([local, method, params, done]() { local->invoke(method, params, done); });
+                return true;
+            }
+            // 本进程中监听 host 的服务端点，未开启短路或不在本进程时返回空
+            LocalEndpoint::ptr localEndpoint(const HostInfo &host)
+            {
+                if (!_local_enabled.load(std::memory_order_acquire)) return LocalEndpoint::ptr();
+                return LocalRegistry::instance().find(host);
+            }
+            // 对冲调用：先发主请求，延迟到期仍未完成且预算允许时向另一台主机发副本，先成功者完成 done
+            // 一路以可重试的错误（连接断开/内部错误/过载）失败而另一路仍在途时等待另一路，全部失败才以错误完成
+            bool invokeHedged(const HedgeState::ptr &hedge, const RoutePtr &route, const std::string &method, const Json::Value &params,
+                              const std::string &hash_key, const RpcCaller::StatusCallback &done,
+                              const HostInfo &exclude = HostInfo(), HostInfo *chosen = nullptr, RespCode *failure = nullptr)
+            {
+                struct HedgeRace
+                {
+                    std::atomic<bool> finished{false};
+                    std::atomic<int> outstanding{1};// 在途的请求数（主请求 + 已发出的副本）
+                    std::atomic<int> failed_rcode{static_cast<int>(RespCode::CONNECTION_CLOSED)};// 先失败一路的错误码
+                    HostInfo primary;
+                    std::chrono::steady_clock::time_point start;
+                };
+                auto race = std::make_shared<HedgeRace>();
+                race->start = std::chrono::steady_clock::now();
+                auto finish = [hedge, race, done](bool is_hedge) -> RpcCaller::StatusCallback {
+                    return [hedge, race, done, is_hedge](RespCode rcode, const Json::Value &result) {
+                        if (race->finished.load()) return;// 输家的响应直接忽略
+                        bool last = race->outstanding.fetch_sub(1) == 1;
+                        if (rcode != RespCode::SUCCESS && RetryState::retryable(rcode) && !last)
+                        {
+                            race->failed_rcode.store(static_cast<int>(rcode));
+                            return;// 另一路仍可能成功
+                        }
+                        if (race->finished.exchange(true)) return;
+                        if (rcode == RespCode::SUCCESS)
+                        {
+                            auto cost = std::chrono::steady_clock::now() - race->start;
+                            hedge->recordLatency(std::chrono::duration_cast<std::chrono::microseconds>(cost).count());
+                            if (is_hedge) hedge->onHedgeWin();
+                        }
+                        done(rcode, result);
+                    };
+                };
+                if (!sendTo(method, params, hash_key, finish(false), exclude, &race->primary, route, failure)) return false;
+                if (chosen) *chosen = race->primary;
+                hedge->onRequest();
+                double delay_sec = static_cast<double>(hedge->delayUs()) / 1000000.0;
+                timerLoop()->runAfter(delay_sec, [this, hedge, route, race, method, params, hash_key, finish, done]() {
+                    if (race->finished.load()) return;
+                    if (!hedge->tryHedge()) return;// 超出对冲预算
+                    race->outstanding.fetch_add(1);
+                    if (!sendTo(method, params, hash_key, finish(true), race->primary, nullptr, route))
+                    {
+                        DLOG("对冲请求未发出（没有其他可用提供者）method=%s", method.c_str());
+                        // 副本没发出：若主请求已经失败并在等副本，这里代它以错误完成
+                        if (race->outstanding.fetch_sub(1) == 1 && !race->finished.exchange(true))
+                        {
+                            done(static_cast<RespCode>(race->failed_rcode.load()), Json::Value());
+                        }
+                    }
+                });
+                return true;
+            }
+            MethodPolicies::ptr methodPolicies(const std::string &method)
+            {
+                auto policies = _policies.load();
+                auto it = policies->find(method);
+                return it == policies->end() ? MethodPolicies::ptr() : it->second;
+            }
+            // 复制该方法的策略修改后发布，并让缓存着旧策略的路由失效
+            template <typename Modify>
+            void updatePolicies(const std::string &method, Modify modify)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(_policy_mutex);
+                    auto next = std::make_shared<PolicyTable>(*_policies.load());
+                    auto it = next->find(method);
+                    auto policies = std::make_shared<MethodPolicies>(it == next->end() ? MethodPolicies() : *it->second);
+                    modify(*policies);
+                    (*next)[method] = std::move(policies);
+                    _policies.store(std::move(next));
+                }
+                invalidateRoute(method);
+            }
+            // 主机的并发限制器，未开启时返回空；首次用到某台主机时创建
+            ConcurrencyLimiter::ptr hostLimiter(const HostInfo &host)
+            {
+                if (!_limiter_enabled.load(std::memory_order_acquire)) return ConcurrencyLimiter::ptr();
+                auto limiters = _limiters.load();
+                auto it = limiters->find(host);
+                if (it != limiters->end()) return it->second;
+                std::unique_lock<std::mutex> lock(_limiter_mutex);
+                auto next = std::make_shared<LimiterMap>(*_limiters.load());
+                auto &limiter = (*next)[host];
+                if (limiter.get() == nullptr) limiter = std::make_shared<ConcurrencyLimiter>(*_limiter_policy);
+                auto ret = limiter;
+                _limiters.store(std::move(next));
+                return ret;
+            }
+            bool delayedPoliciesInUse()
+            {
+                for (const auto &item : *_policies.load())
+                {
+                    if (item.second->hedge || item.second->retry) return true;
+                }
+                return false;
+            }
+            // 向每条连接发送一个空操作请求并等待全部应答
+            bool probeClients(const std::vector<BaseClient::ptr> &clients)
+            {
+                std::vector<Promise<Json::Value>> promises(clients.size());
+                std::vector<RpcCaller::RpcAsyncRespose> futures;
+                for (size_t i = 0; i < clients.size(); ++i)
+                {
+                    futures.push_back(promises[i].future());
+                    auto conn = clients[i] ? clients[i]->connection() : BaseConnection::ptr();
+                    if (conn.get() == nullptr || !_caller->call(conn, METHOD_PING, Json::Value(), fulfill(promises[i])))
+                    {
+                        promises[i].setError(RespCode::CONNECTION_CLOSED);
+                    }
+                }
+                bool ok = true;
+                for (auto &future : futures)
+                {
+                    if (future.rcode() == RespCode::CONNECTION_CLOSED)// 其他响应码也说明对端已应答（不认识内置方法的旧版本服务端回 SERVICE_NOT_FOUND）
+                    {
+                        WLOG("预热探测失败：%s", errReason(future.rcode()).c_str());
+                        ok = false;
+                    }
+                }
+                return ok;
+            }
+            // 定时器线程按需启动，只有用到对冲/重试等延迟任务时才创建
+            muduo::net::EventLoop *timerLoop()
+            {
+                std::call_once(_timer_once, [this] { _timer_loop_ptr = _timer_loop.startLoop(); });
+                return _timer_loop_ptr;
+            }
+            // 按 getClient 选出的提供者分组，每组一次 callBatch；选不到提供者或连接不可用的请求直接回报错误
+            bool dispatchBatch(const RpcCaller::BatchRequest &calls, const RpcCaller::BatchReplyCallback &on_reply)
+            {
+                struct BatchGroup
+                {
+                    HostInfo host;
+                    std::vector<size_t> idxs;
+                };
+                std::unordered_map<BaseClient::ptr, BatchGroup> groups; // 提供者 -> 主机与请求下标
+                std::vector<size_t> not_found;
+                bool sent = false;
+                for (size_t i = 0; i < calls.size(); ++i)
+                {
+                    Target target;
+                    BaseClient::ptr client = getClient(calls[i].first, std::string(), HostInfo(), target);
+                    if (target.local.get() != nullptr)
+                    {
+                        dispatchLocal(target.local, calls[i].first, calls[i].second, [on_reply, i](RespCode rcode, const Json::Value &result) {
+                            on_reply(i, rcode, result);
+                        });
+                        sent = true;
+                        continue;
+                    }
+                    if (client.get() == nullptr)
+                    {
+                        ELOG("服务获取失败：%s", calls[i].first.c_str());
+                        not_found.push_back(i);
+                        continue;
+                    }
+                    auto &group = groups[client];
+                    group.host = target.host;
+                    group.idxs.push_back(i);
+                }
+                // 结果反馈需要方法名，回调可能晚于 calls 的生命周期，只复制方法名
+                std::shared_ptr<std::vector<std::string>> methods;
+                if (_enablediscover && !groups.empty())
+                {
+                    methods = std::make_shared<std::vector<std::string>>(calls.size());
+                    for (size_t i = 0; i < calls.size(); ++i) (*methods)[i] = calls[i].first;
+                }
+                for (auto &group : groups)
+                {
+                    if (sendBatch(group.first->connection(), group.second.host, calls, group.second.idxs, methods, on_reply)) sent = true;
+                }
+                for (size_t idx : not_found) on_reply(idx, RespCode::SERVICE_NOT_FOUND, Json::Value());
+                return sent;
+            }
+            // 发往同一提供者的一组请求：开启并发限制时每个请求各占一个名额，与单个调用一样受主机上限约束
+            // 立即拿到名额的请求仍合并成一次写；排队后才放行的请求由放行方单独发送；队列满或排队超时的以 OVERLOADED 回报
+            // 返回是否有请求发出或在排队
+            bool sendBatch(const BaseConnection::ptr &conn, const HostInfo &host, const RpcCaller::BatchRequest &calls,
+                           const std::vector<size_t> &idxs, const std::shared_ptr<std::vector<std::string>> &methods,
+                           const RpcCaller::BatchReplyCallback &on_reply)
+            {
+                ConcurrencyLimiter::ptr limiter = conn.get() != nullptr ? hostLimiter(host) : ConcurrencyLimiter::ptr();
+                if (limiter.get() == nullptr) return writeBatch(conn, host, calls, idxs, methods, on_reply);
+                struct Collector
+                {
+                    std::mutex mutex;
+                    bool open = true;// 仍在逐个申请名额，期间放行的请求并入这次合并写
+                    std::vector<size_t> ready;
+                    size_t rejected = 0;
+                };
+                auto collector = std::make_shared<Collector>();
+                auto start = std::chrono::steady_clock::now();
+                // 完成时归还名额，与 sendTo 相同：连接断开/过载不计延迟样本而是收缩上限
+                auto limited = [limiter, start, on_reply](size_t idx, RespCode rcode, const Json::Value &result) {
+                    auto cost = std::chrono::steady_clock::now() - start;
+                    bool dropped = rcode == RespCode::CONNECTION_CLOSED || rcode == RespCode::OVERLOADED;
+                    limiter->release(std::chrono::duration_cast<std::chrono::microseconds>(cost).count(), dropped);
+                    on_reply(idx, rcode, result);
+                };
+                for (size_t idx : idxs)
+                {
+                    const std::string &method = calls[idx].first;
+                    const Json::Value &params = calls[idx].second;
+                    limiter->submit([this, limiter, collector, idx, method, params, host, conn, on_reply](bool admitted) {
+                        {
+                            std::unique_lock<std::mutex> lock(collector->mutex);
+                            if (collector->open)
+                            {
+                                if (admitted) collector->ready.push_back(idx);
+                                else ++collector->rejected;
+                            }
+                        }
+                        if (!admitted)
+                        {
+                            on_reply(idx, RespCode::OVERLOADED, Json::Value());
+                            return;
+                        }
+                        {
+                            std::unique_lock<std::mutex> lock(collector->mutex);
+                            if (collector->open) return;
+                        }
+                        auto begin = std::chrono::steady_clock::now();
+                        auto on_done = [limiter, begin, on_reply, idx](RespCode rcode, const Json::Value &result) {
+                            auto cost = std::chrono::steady_clock::now() - begin;
+                            bool dropped = rcode == RespCode::CONNECTION_CLOSED || rcode == RespCode::OVERLOADED;
+                            limiter->release(std::chrono::duration_cast<std::chrono::microseconds>(cost).count(), dropped);
+                            on_reply(idx, rcode, result);
+                        };
+                        if (!dispatch(method, params, host, conn, on_done))
+                        {
+                            limiter->release(0, true);
+                            on_reply(idx, RespCode::CONNECTION_CLOSED, Json::Value());
+                        }
+                    });
+                }
+                std::vector<size_t> ready;
+                size_t rejected = 0;
+                {
+                    std::unique_lock<std::mutex> lock(collector->mutex);
+                    collector->open = false;
+                    ready.swap(collector->ready);
+                    rejected = collector->rejected;
+                }
+                if (!ready.empty()) writeBatch(conn, host, calls, ready, methods, limited);
+                return rejected < idxs.size();
+            }
+            // 一组请求合并成一次写发往同一提供者；开启服务发现时与 dispatch 一样记录在途数、耗时与结果
+            // 未能发出的请求在这里以 CONNECTION_CLOSED 回报，返回是否发出
+            bool writeBatch(const BaseConnection::ptr &conn, const HostInfo &host, const RpcCaller::BatchRequest &calls,
+                            const std::vector<size_t> &idxs, const std::shared_ptr<std::vector<std::string>> &methods,
+                            const RpcCaller::BatchReplyCallback &on_reply)
+            {
+                auto discover = _enablediscover ? _discover_client : ClientDiscover::ptr();
+                if (conn.get() == nullptr)
+                {
+                    for (size_t idx : idxs)
+                    {
+                        if (discover) discover->onResult(calls[idx].first, host, RespCode::CONNECTION_CLOSED, 0);
+                        on_reply(idx, RespCode::CONNECTION_CLOSED, Json::Value());
+                    }
+                    return false;
+                }
+                RpcCaller::BatchReplyCallback reply = on_reply;
+                if (discover)
+                {
+                    auto start = std::chrono::steady_clock::now();
+                    for (size_t idx : idxs) discover->onSend(calls[idx].first, host);
+                    reply = [discover, methods, host, start, on_reply](size_t idx, RespCode rcode, const Json::Value &result) {
+                        auto cost = std::chrono::steady_clock::now() - start;
+                        discover->onResult((*methods)[idx], host, rcode, std::chrono::duration_cast<std::chrono::microseconds>(cost).count());
+                        on_reply(idx, rcode, result);
+                    };
+                }
+                if (_caller->callBatch(conn, calls, idxs, reply)) return true;
+                for (size_t idx : idxs)
+                {
+                    if (discover) discover->onResult(calls[idx].first, host, RespCode::CONNECTION_CLOSED, 0);
+                    on_reply(idx, RespCode::CONNECTION_CLOSED, Json::Value());
+                }
+                return false;
+            }
             void delClient(const HostInfo &host)
             {
-                std::unique_lock<std::mutex> lock(_mutex);
-                _rpc_clients.erase(host);
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _rpc_clients.erase(host);
+                }
+                clearRoutes();
+            }
+            // 已建立的方法路由，未开启服务发现或尚未建立时返回空
+            RoutePtr findRoute(const std::string &method)
+            {
+                if (!_enablediscover) return RoutePtr();
+                auto routes = _routes.load();
+                auto it = routes->find(method);
+                return it == routes->end() ? RoutePtr() : it->second;
+            }
+            // 路由表快速路径：直接在缓存的主机快照上选择，按下标取已建立的连接，不加锁、不打日志
+            // 选中的主机还没有连接或连接已断开时返回空，由慢路径处理；选中本进程的提供者时返回空连接并通过 target.local 返回端点
+            BaseClient::ptr routeClient(const RoutePtr &route, const std::string &hash_key, const HostInfo &exclude, Target &target)
+            {
+                int pos = route->method_host->selectIndex(*route->snapshot, _loadbalance_strategy, hash_key, exclude);
+                if (pos < 0) return BaseClient::ptr();
+                if (!route->locals.empty())
+                {
+                    target.local = route->locals[pos].lock();
+                    if (target.local.get() != nullptr)
+                    {
+                        target.host = route->snapshot->hosts[pos].host;
+                        return BaseClient::ptr();
+                    }
+                }
+                const BaseClient::ptr &client = route->clients[pos];
+                if (client.get() == nullptr || !client->connected()) return BaseClient::ptr();
+                target.host = route->snapshot->hosts[pos].host;
+                target.route = route;
+                target.pos = static_cast<size_t>(pos);
+                return client;
+            }
+            // 用当前主机快照、连接池、限制器和方法策略重建方法路由；尚未建立连接的主机留空，等慢路径建立连接后再次重建
+            void buildRoute(const std::string &method)
+            {
+                uint64_t epoch = _route_epoch.load(std::memory_order_acquire);
+                MethodHost::ptr method_host = _discover_client->methodHost(method);
+                if (method_host.get() == nullptr) return;
+                auto route = std::make_shared<Route>();
+                route->method_host = method_host;
+                route->snapshot = method_host->snapshot();
+                route->policies = methodPolicies(method);
+                route->clients.reserve(route->snapshot->hosts.size());
+                bool has_local = false;
+                for (const auto &detail : route->snapshot->hosts)
+                {
+                    LocalEndpoint::ptr local = localEndpoint(detail.host);
+                    has_local = has_local || local.get() != nullptr;
+                    route->locals.push_back(local);
+                }
+                if (!has_local) route->locals.clear();// 常见情况：没有本进程的提供者，选择路径不做检查
+                if (_limiter_enabled.load(std::memory_order_acquire))
+                {
+                    for (const auto &detail : route->snapshot->hosts) route->limiters.push_back(hostLimiter(detail.host));
+                }
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    for (const auto &detail : route->snapshot->hosts)
+                    {
+                        auto pool_it = _rpc_clients.find(detail.host);
+                        route->clients.push_back(pool_it == _rpc_clients.end() ? BaseClient::ptr() : pool_it->second);
+                    }
+                }
+                std::unique_lock<std::mutex> lock(_route_mutex);
+                // 构建期间主机列表或配置又变了，失效通知已经或即将到来，不发布过期路由
+                if (_route_epoch.load(std::memory_order_relaxed) != epoch || route->snapshot != method_host->snapshot()) return;
+                auto next = std::make_shared<RouteTable>(*_routes.load());
+                (*next)[method] = route;
+                _routes.store(std::move(next));
+            }
+            void invalidateRoute(const std::string &method)
+            {
+                std::unique_lock<std::mutex> lock(_route_mutex);
+                _route_epoch.fetch_add(1, std::memory_order_release);
+                auto cur = _routes.load();
+                if (cur->find(method) == cur->end()) return;
+                auto next = std::make_shared<RouteTable>(*cur);
+                next->erase(method);
+                _routes.store(std::move(next));
+            }
+            void clearRoutes()
+            {
+                std::unique_lock<std::mutex> lock(_route_mutex);
+                _route_epoch.fetch_add(1, std::memory_order_release);
+                _routes.store(std::make_shared<RouteTable>());
             }
             BaseClient::ptr newClient(const HostInfo &host)
             {
@@ -252,33 +1202,53 @@ namespace lcz_rpc
                 client = lcz_rpc::ClientFactory::create(host.first, host.second);
                 client->setMessageCallback(msg_cb);
                 // client->setConnectionCallback(onConnection);
+                client->setCloseCallback(std::bind(&Requestor::onClose, _requestor.get(), std::placeholders::_1));//连接断开时让等待中的请求失败，重试才能及时介入
                 client->connect();
+                _caller->handshake(client->connection());// 取得方法 ID 表，之后的请求在帧头携带 ID
                 putClient(host, client);
                 return client;
             }
-            BaseClient::ptr getClient(const std::string &method)
+            // exclude 非空时选择另一台提供者（未开启服务发现时没有其他提供者）；target 返回选中的主机
+            // 选中本进程的提供者会返回空连接并通过 target.local 返回端点，不为它建立连接；route 为空时按方法名查找路由
+            BaseClient::ptr getClient(const std::string &method, const std::string &hash_key, const HostInfo &exclude, Target &target,
+                                      const RoutePtr &route = RoutePtr())
             {
                 BaseClient::ptr client;
                 if (_enablediscover)
                 {
+                    RoutePtr cached = route ? route : findRoute(method);
+                    if (cached)
+                    {
+                        client = routeClient(cached, hash_key, exclude, target);
+                        if (client.get() != nullptr || target.local.get() != nullptr) return client;// 稳态：命中路由表
+                    }
                     HostDetail detail;
                     // 先通过服务发现获取提供者的地址信息
-                    bool ret = _discover_client->serviceDiscover(method, detail,_loadbalance_strategy);
+                    bool ret = _discover_client->serviceDiscover(method, detail,_loadbalance_strategy, exclude, hash_key);
                     if (!ret)
                     {
-                        ELOG("服务发现失败");
+                        if (exclude.first.empty()) ELOG("服务发现失败");
                         return BaseClient::ptr();
                     }
                     HostInfo host = detail.host;
+                    target.host = host;
+                    if ((target.local = localEndpoint(host)).get() != nullptr)
+                    {
+                        buildRoute(method);
+                        return BaseClient::ptr();
+                    }
                     client = getClient(host);
                     // 如果没有实例化客户端就创建一个新的
                     if (client.get() == nullptr)
                     {
                         client = newClient(host);
                     }
+                    buildRoute(method);// 新建连接或主机列表变化后重建路由，后续调用走快速路径
                 }
                 else
                 {
+                    if (!exclude.first.empty()) return BaseClient::ptr();
+                    if ((target.local = localEndpoint(_rpc_host)).get() != nullptr) return BaseClient::ptr();
                     client = _rpc_client;
                 }
                 return client;
@@ -312,13 +1282,34 @@ namespace lcz_rpc
             };
             std::mutex _mutex;
             bool _enablediscover;
+            HostInfo _rpc_host;// 未开启服务发现时的服务端地址
             BaseClient::ptr _rpc_client;
             std::unordered_map<HostInfo, BaseClient::ptr, HostHash> _rpc_clients; // 连接池 -长连接,收到服务下线通知后通过回调删除
+            using RouteTable = std::unordered_map<std::string, RoutePtr>;
+            std::mutex _route_mutex;// 串行化路由表更新，查找路径读快照不加锁
+            std::atomic<uint64_t> _route_epoch{0};// 每次失效 +1，构建期间发生过失效的路由不发布
+            RcuPtr<RouteTable> _routes;
             Requestor::ptr _requestor;
             ClientDiscover::ptr _discover_client; // 服务发现客户端
             RpcCaller::ptr _caller;
             Dispacher::ptr _dispacher;
             LoadBalanceStrategy _loadbalance_strategy;//负载均衡策略
+            Executor::ptr _callback_executor;//回调模式的完成执行器，为空时在 I/O 线程上执行
+            std::atomic<bool> _local_enabled{true};//进程内短路开关
+            Executor::ptr _local_executor;//进程内调用的执行器，为空时在调用线程上执行
+
+            std::mutex _policy_mutex;//串行化按方法策略表的更新，每次调用的查找读快照不加锁
+            RcuPtr<PolicyTable> _policies;//方法 -> 对冲/重试/合并/缓存的配置与状态
+            using LimiterMap = std::unordered_map<HostInfo, ConcurrencyLimiter::ptr, HostHash>;
+            std::mutex _limiter_mutex;//串行化限制器表的更新
+            std::atomic<bool> _limiter_enabled{false};//未开启时调用路径只多一次原子读
+            std::shared_ptr<const LimiterPolicy> _limiter_policy;
+            RcuPtr<LimiterMap> _limiters;//主机 -> 并发限制器
+
+            // 定时器线程放在最后声明：析构时最先停止，保证挂起的定时任务不会访问已销毁的成员
+            std::once_flag _timer_once;
+            muduo::net::EventLoopThread _timer_loop;//对冲/重试等延迟任务使用的定时器线程
+            muduo::net::EventLoop *_timer_loop_ptr = nullptr;
         };
         // 轻量级主题客户端：复用 Requestor 发送 TopicRequest，并对推送消息进行分发
         class TopicClient
@@ -337,8 +1328,11 @@ namespace lcz_rpc
                 auto message_cb=std::bind(&Dispacher::onMessage,_dispacher.get(),std::placeholders::_1,std::placeholders::_2);                
                 _topic_client=lcz_rpc::ClientFactory::create(ip,port);
                 _topic_client->setMessageCallback(message_cb);
+                _topic_client->setCloseCallback(std::bind(&Requestor::onClose,_requestor.get(),std::placeholders::_1));
                 _topic_client->connect();
             }
+            // 订阅回调执行器：为空时在 I/O 线程上执行，耗时的订阅回调应传入线程池，同一主题的消息保持顺序
+            void setCallbackExecutor(const Executor::ptr &executor) { _topicmanager->setExecutor(executor); }
             // 下面几个封装函数都直接复用 TopicManager，同步等待服务端确认
             bool createTopic(const std::string &topic_name) {return _topicmanager->createTopic(_topic_client->connection(),topic_name);}
             bool removeTopic( const std::string &topic_name) {return _topicmanager->removeTopic(_topic_client->connection(),topic_name);}
@@ -1,143 +1,598 @@
 #pragma once
 #include "requestor.hpp"
+#include "hash_ring.hpp"
 #include <algorithm>
 #include <random>
 #include <chrono> 
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include "../general/rcu.hpp"
 #include "../general/publicconfig.hpp"
 
-static constexpr int MAX_IDX = 1000000000; //最大索引
-
 namespace lcz_rpc
 {
     namespace client
     {
         //在client命名空间定义的HostDetail结构体，用于存储主机信息和负载信息
       //搬去了general/publicconfig.hpp中
+        //单台主机的运行状态：被动健康检查与 P2C 的输入，选择路径只做原子读
+        //同一主机在前后快照之间共享同一个状态对象，主机列表变化不会丢失统计
+        struct HostState
+        {
+            using ptr = std::shared_ptr<HostState>;
+            std::atomic<int> load{0};//最近一次上报的负载：刷新只改这里，负载变化不需要发布新快照
+            std::atomic<int> inflight{0};//在途请求数
+            std::atomic<int> consecutive_failures{0};//连续失败次数
+            std::atomic<double> error_ewma{0};//错误率 EWMA
+            std::atomic<double> latency_ewma_us{0};//成功请求延迟 EWMA（微秒）
+            std::atomic<int64_t> latency_update_us{0};//最近一次更新延迟的时间，长时间未更新时延迟按时间衰减
+            std::atomic<uint64_t> samples{0};//样本数
+            std::atomic<bool> ejected{false};//是否处于摘除状态
+            std::atomic<bool> probing{false};//半开探测请求是否在途
+            std::atomic<int> eject_count{0};//连续被摘除次数，决定摘除时长
+            std::atomic<int64_t> ejected_until_us{0};//摘除到期时间
+            std::atomic<int64_t> probe_deadline_us{0};//探测请求迟迟不返回时，到期后允许再次探测
+            int64_t wrr_current = 0;//平滑加权轮询的当前权重，由 MethodHost::_wrr_mutex 保护
+            std::mutex mutex;//摘除/恢复这类状态迁移串行执行，频率很低
+        };
+        //不可变的主机列表快照：上下线/刷新时复制一份修改后原子替换，选择路径只读当前快照
+        //hosts[i].load 只是快照发布时的负载，当前负载读 states[i]->load
+        struct HostSnapshot
+        {
+            std::vector<HostDetail> hosts;
+            std::vector<HostState::ptr> states;//与 hosts 一一对应
+            HashRing ring;//SOURCE_HASH 使用的一致性哈希环
+            HealthPolicy policy;//被动健康检查配置
+            Locality self;//客户端自身的位置标签，为空时不做就近路由
+            LocalityPolicy locality_policy;//就近路由的溢出阈值
+            std::vector<int> tiers;//与 hosts 一一对应：0 同机 1 同机架 2 同可用区 3 其他
+            int find(const HostInfo &host) const
+            {
+                for (size_t i = 0; i < hosts.size(); ++i)
+                {
+                    if (hosts[i].host == host) return static_cast<int>(i);
+                }
+                return -1;
+            }
+        };
+        //候选主机集合：idx 为空表示快照中的全部主机，常见情况下不需要分配候选数组
+        struct HostCandidates
+        {
+            const std::vector<size_t> *idx = nullptr;
+            size_t all = 0;
+            size_t size() const { return idx ? idx->size() : all; }
+            size_t operator[](size_t i) const { return idx ? (*idx)[i] : i; }
+        };
         class MethodHost
         {
         public:
             using ptr = std::shared_ptr<MethodHost>;
-            MethodHost(const std::vector<HostDetail>& host) : _idx(0),_host(host),_rng(std::random_device()()),_hash() {}
-            MethodHost() : _idx(0),_rng(std::random_device()()/*使用随机数生成器生成种子*/),_hash() {}
-            void appendHost(const HostInfo &host,int load)
+            MethodHost(const std::vector<HostDetail>& host) : _idx(0)
             {
-                std::unique_lock<std::mutex> lock(_mutex);
+                updateHosts(host);
+            }
+            MethodHost() : _idx(0) {}
+            void appendHost(const HostDetail &detail)
+            {
+                std::unique_lock<std::mutex> lock(_write_mutex);
+                auto next = std::make_shared<HostSnapshot>(*_snapshot.load());
                 //服务发现/负载上报可能多次收到同一个 host，如果老值不覆盖，新策略会永远看到旧负载
-                auto it =std::find_if(_host.begin(),_host.end(),[&](const HostDetail& detail){return detail.host == host;});
-                if(it!=_host.end())//在host存在时，更新负载就返回
+                int pos = next->find(detail.host);
+                if (pos >= 0)//在host存在时，更新负载、权重和位置就返回，加权轮询的当前权重保留在主机状态中
+                {
+                    next->hosts[pos] = detail;
+                    next->states[pos]->load.store(detail.load, std::memory_order_relaxed);
+                }
+                else
+                {
+                    next->hosts.push_back(detail);
+                    next->states.push_back(newState(detail));
+                    next->ring.addHost(detail.host);//上线只插入新主机的虚拟节点
+                }
+                assignTiers(*next);
+                _snapshot.store(std::move(next));
+            }
+            //用注册中心返回的最新列表整体替换主机列表，保留仍在列表中的主机的健康状态和加权轮询进度
+            //主机集合、权重和位置都没变时（定时刷新的常见情况）只更新负载，不发布新快照，返回 false；否则发布并返回 true
+            bool updateHosts(const std::vector<HostDetail> &hosts)
+            {
+                std::unique_lock<std::mutex> lock(_write_mutex);
+                auto cur = _snapshot.load();
+                if (sameHosts(*cur, hosts))
+                {
+                    for (const auto &detail : hosts) cur->states[cur->find(detail.host)]->load.store(detail.load, std::memory_order_relaxed);
+                    return false;
+                }
+                auto next = std::make_shared<HostSnapshot>();
+                next->policy = cur->policy;
+                next->ring = cur->ring;
+                for (const auto &detail : cur->hosts)
                 {
-                    it->load = load;
+                    bool alive = std::any_of(hosts.begin(), hosts.end(), [&](const HostDetail &item) { return item.host == detail.host; });
+                    if (!alive) next->ring.removeHost(detail.host);
+                }
+                for (const auto &detail : hosts)
+                {
+                    if (next->find(detail.host) >= 0) continue;//注册中心返回重复主机时只保留一份
+                    int pos = cur->find(detail.host);
+                    next->hosts.push_back(detail);
+                    next->states.push_back(pos >= 0 ? cur->states[pos] : newState(detail));
+                    next->states.back()->load.store(detail.load, std::memory_order_relaxed);
+                    next->ring.addHost(detail.host);//已存在的主机会被忽略
+                }
+                next->self = cur->self;
+                next->locality_policy = cur->locality_policy;
+                assignTiers(*next);
+                _snapshot.store(std::move(next));
+                return true;
+            }
+            void setHealthPolicy(const HealthPolicy &policy)
+            {
+                std::unique_lock<std::mutex> lock(_write_mutex);
+                auto next = std::make_shared<HostSnapshot>(*_snapshot.load());
+                next->policy = policy;
+                _snapshot.store(std::move(next));
+            }
+            //客户端自身位置与就近路由阈值；self 为空时关闭就近路由
+            void setLocality(const Locality &self, const LocalityPolicy &policy)
+            {
+                std::unique_lock<std::mutex> lock(_write_mutex);
+                auto next = std::make_shared<HostSnapshot>(*_snapshot.load());
+                next->self = self;
+                next->locality_policy = policy;
+                assignTiers(*next);
+                _snapshot.store(std::move(next));
+            }
+            //根据负载均衡策略选择主机；exclude 非空时跳过该主机（对冲/重试需要换一台）
+            //被摘除的主机对所有策略都不可见；全部不可用时进入恐慌模式，忽略健康状态在全部主机中选择
+            //只读当前快照，不加锁；轮询下标为原子量，随机数生成器为线程局部
+            HostDetail selectHost(LoadBalanceStrategy strategy, const std::string &key = {}, const HostInfo &exclude = HostInfo())
+            {
+                auto snap = _snapshot.load();
+                int pos = selectIndex(*snap, strategy, key, exclude);
+                if (pos < 0) return HostDetail();//如果没有可选主机，则返回空
+                HostDetail detail = snap->hosts[pos];
+                detail.load = snap->states[pos]->load.load(std::memory_order_relaxed);
+                return detail;
+            }
+            using Snapshot = std::shared_ptr<const HostSnapshot>;
+            Snapshot snapshot() const { return _snapshot.load(); }
+            //在给定快照上选择主机，返回下标，-1 表示没有可选主机；供调用方缓存快照并按下标直接取连接
+            //开启就近路由时先选出最近的合格层，负载均衡策略只在该层内挑选
+            int selectIndex(const HostSnapshot &cur, LoadBalanceStrategy strategy, const std::string &key = {}, const HostInfo &exclude = HostInfo())
+            {
+                if (cur.hosts.empty()) return -1;
+                int64_t now = nowUs();
+                if (!cur.tiers.empty())
+                {
+                    std::vector<size_t> local;
+                    if (selectTier(cur, exclude, now, local))
+                    {
+                        HostCandidates candidates;
+                        candidates.idx = &local;
+                        size_t pos = pickHost(cur, candidates, strategy, key);
+                        markProbe(cur, pos, now);
+                        return static_cast<int>(pos);
+                    }
+                }
+                HostCandidates all;
+                all.all = cur.hosts.size();
+                bool filtered = false;
+                for (size_t i = 0; i < cur.hosts.size(); ++i)
+                {
+                    if (cur.hosts[i].host == exclude || !available(cur, i, now))
+                    {
+                        filtered = true;
+                        break;
+                    }
+                }
+                if (!filtered)//常见情况：没有需要过滤的主机，不分配候选数组
+                {
+                    size_t pos = pickHost(cur, all, strategy, key);
+                    markProbe(cur, pos, now);
+                    return static_cast<int>(pos);
+                }
+                std::vector<size_t> idx;
+                idx.reserve(cur.hosts.size());
+                for (size_t i = 0; i < cur.hosts.size(); ++i)
+                {
+                    if (cur.hosts[i].host != exclude && available(cur, i, now)) idx.push_back(i);
+                }
+                bool panic = idx.empty();
+                if (panic)
+                {
+                    for (size_t i = 0; i < cur.hosts.size(); ++i)
+                    {
+                        if (cur.hosts[i].host != exclude) idx.push_back(i);
+                    }
+                    if (idx.empty()) return -1;
+                }
+                HostCandidates candidates;
+                candidates.idx = &idx;
+                size_t pos = pickHost(cur, candidates, strategy, key);
+                if (!panic) markProbe(cur, pos, now);
+                return static_cast<int>(pos);
+            }
+            //请求发出：在途数 +1，与 onResult 成对调用
+            void onSend(const HostInfo &host)
+            {
+                HostState::ptr state = findState(host);
+                if (state) state->inflight.fetch_add(1, std::memory_order_relaxed);
+            }
+            //调用方已经持有选择时用的快照和下标（路由缓存）：直接更新主机状态，不再读快照、按主机查找
+            static void onSend(const HostSnapshot &snap, size_t pos) { snap.states[pos]->inflight.fetch_add(1, std::memory_order_relaxed); }
+            //调用结果反馈：success 表示主机正常应答，latency_us 为成功请求的耗时
+            void onResult(const HostInfo &host, bool success, int64_t latency_us)
+            {
+                auto snap = _snapshot.load();
+                int pos = snap->find(host);
+                if (pos < 0) return;
+                onResult(*snap, pos, success, latency_us);
+            }
+            void onResult(const HostSnapshot &snap, size_t pos, bool success, int64_t latency_us)
+            {
+                const HostInfo &host = snap.hosts[pos].host;
+                HostState &state = *snap.states[pos];
+                const HealthPolicy &policy = snap.policy;
+                int64_t now = nowUs();
+                if (state.inflight.fetch_sub(1, std::memory_order_relaxed) <= 0) state.inflight.fetch_add(1, std::memory_order_relaxed);//防止未配对的完成把在途数减成负数
+                if (success)
+                {
+                    updateEwma(state.latency_ewma_us, static_cast<double>(latency_us), true);
+                    state.latency_update_us.store(now, std::memory_order_relaxed);
+                }
+                if (!policy.enable) return;
+                uint64_t samples = state.samples.fetch_add(1, std::memory_order_relaxed) + 1;
+                updateEwma(state.error_ewma, success ? 0.0 : 1.0, false);
+                int failures = 0;
+                if (success) state.consecutive_failures.store(0, std::memory_order_relaxed);
+                else failures = state.consecutive_failures.fetch_add(1, std::memory_order_relaxed) + 1;
+                if (state.ejected.load(std::memory_order_acquire))
+                {
+                    if (!state.probing.exchange(false)) return;//摘除前发出的请求陆续返回，不影响状态
+                    std::unique_lock<std::mutex> lock(state.mutex);
+                    if (success && !tooSlow(policy, state))
+                    {
+                        state.consecutive_failures.store(0, std::memory_order_relaxed);
+                        state.error_ewma.store(0, std::memory_order_relaxed);
+                        int count = state.eject_count.load(std::memory_order_relaxed);
+                        if (count > 0) state.eject_count.store(count - 1, std::memory_order_relaxed);
+                        state.ejected.store(false, std::memory_order_release);
+                        ILOG("[健康检查] 主机 %s:%d 探测成功，恢复流量", host.first.c_str(), host.second);
+                    }
+                    else eject(policy, host, state, now);
                     return;
                 }
-                _host.emplace_back(HostDetail{host,load});
+                bool bad = failures >= policy.consecutive_failures;
+                if (samples >= static_cast<uint64_t>(policy.min_requests))
+                {
+                    bad = bad || state.error_ewma.load(std::memory_order_relaxed) > policy.error_rate || tooSlow(policy, state);
+                }
+                if (!bad) return;
+                std::unique_lock<std::mutex> lock(_eject_mutex);//摘除比例检查与摘除放在一起，避免并发摘除超过上限
+                if (!state.ejected.load(std::memory_order_acquire) && canEject(snap)) eject(policy, host, state, now);
             }
-            //根据负载均衡策略选择主机
-            HostDetail selectHost(LoadBalanceStrategy strategy, const std::string &key = {})
+            //连接断开、服务端内部错误和过载拒绝计为失败，其余响应说明主机能正常应答
+            //过载拒绝返回得很快，若当作成功会把极短的耗时计入延迟，反而让 P2C_LATENCY 把更多流量导向过载的主机
+            static bool healthyResponse(RespCode rcode)
+            {
+                return rcode != RespCode::CONNECTION_CLOSED && rcode != RespCode::INTERNAL_ERROR && rcode != RespCode::OVERLOADED;
+            }
+            //通过find_if+lambda判断是否存在，存在则删除
+            void removeHost(const HostInfo &host)
+            {
+                std::unique_lock<std::mutex> lock(_write_mutex);
+                auto next = std::make_shared<HostSnapshot>(*_snapshot.load());
+                int pos = next->find(host);
+                if (pos < 0) return;
+                next->hosts.erase(next->hosts.begin() + pos);
+                next->states.erase(next->states.begin() + pos);
+                next->ring.removeHost(host);//下线只移除该主机的虚拟节点
+                assignTiers(*next);
+                _snapshot.store(std::move(next));
+            }
+            HostInfo getHost()
+            {
+                return selectHost(LoadBalanceStrategy::ROUND_ROBIN).host;
+            }
+            HostDetail getHostDetail()
+            {
+                return selectHost(LoadBalanceStrategy::ROUND_ROBIN);
+            }
+            bool empty()
+            {
+                return _snapshot.load()->hosts.empty();
+            }
+
+        private:
+            //离客户端的距离层级：0 同机 1 同机架 2 同可用区 3 其他（含未打标签）
+            static int localityTier(const Locality &self, const Locality &other)
+            {
+                if (self.zone.empty() || other.zone != self.zone) return kTierCount - 1;
+                if (self.rack.empty() || other.rack != self.rack) return 2;
+                if (self.node.empty() || other.node != self.node) return 1;
+                return 0;
+            }
+            //写者持有 _write_mutex：主机列表或自身位置变化后重新计算每台主机的层级，选择路径只读
+            static void assignTiers(HostSnapshot &snap)
+            {
+                snap.tiers.clear();
+                if (snap.self.empty()) return;
+                snap.tiers.reserve(snap.hosts.size());
+                for (const auto &detail : snap.hosts) snap.tiers.push_back(localityTier(snap.self, detail.locality));
+            }
+            //从近到远找第一个合格的层：可用主机数、可用占比、平均负载都满足阈值；都不合格时返回 false，退回全部主机
+            bool selectTier(const HostSnapshot &cur, const HostInfo &exclude, int64_t now, std::vector<size_t> &local)
+            {
+                int total[kTierCount] = {0}, healthy[kTierCount] = {0};
+                int64_t load[kTierCount] = {0};
+                for (size_t i = 0; i < cur.hosts.size(); ++i)
+                {
+                    if (cur.hosts[i].host == exclude) continue;
+                    int tier = cur.tiers[i];
+                    ++total[tier];
+                    if (!available(cur, i, now)) continue;
+                    ++healthy[tier];
+                    load[tier] += cur.states[i]->load.load(std::memory_order_relaxed);
+                }
+                const LocalityPolicy &policy = cur.locality_policy;
+                for (int tier = 0; tier < kTierCount; ++tier)
+                {
+                    if (healthy[tier] == 0 || healthy[tier] < policy.min_hosts) continue;
+                    if (healthy[tier] < policy.min_healthy_ratio * total[tier]) continue;
+                    if (load[tier] > static_cast<int64_t>(policy.max_load) * healthy[tier]) continue;
+                    local.reserve(healthy[tier]);
+                    for (size_t i = 0; i < cur.hosts.size(); ++i)
+                    {
+                        if (cur.tiers[i] == tier && cur.hosts[i].host != exclude && available(cur, i, now)) local.push_back(i);
+                    }
+                    return true;
+                }
+                return false;
+            }
+            //在候选集合上按策略选择主机，返回快照中的下标
+            size_t pickHost(const HostSnapshot &cur, const HostCandidates &candidates, LoadBalanceStrategy strategy, const std::string &key)
             {
-                std::unique_lock<std::mutex> lock(_mutex);
-                if (_host.empty()) return HostDetail();//如果主机列表为空，则返回空
                 switch (strategy)
                 {
                     case LoadBalanceStrategy::ROUND_ROBIN:
-                    return pickRoundRobin();
+                    return pickRoundRobin(candidates);
                     case LoadBalanceStrategy::RANDOM:
-                        return pickRandom();
+                        return pickRandom(candidates);
                     case LoadBalanceStrategy::SOURCE_HASH:
-                        return pickSourceHash(key);
+                        return pickSourceHash(cur, candidates, key);
                     case LoadBalanceStrategy::LOWEST_LOAD:
-                        return pickLowestLoad();
+                        return pickLowestLoad(cur, candidates);
+                    case LoadBalanceStrategy::P2C_LATENCY:
+                        return pickP2C(cur, candidates);
+                    case LoadBalanceStrategy::WEIGHTED_ROUND_ROBIN:
+                        return pickWeightedRoundRobin(cur, candidates);
                 }
-                return HostDetail();//如果策略不合法，则返回空
+                return candidates[0];//策略不合法时取第一个候选
             }
-            //轮询算法选择主机
-            HostDetail pickRoundRobin() 
+            //轮询算法选择主机：原子递增，多线程并发选择互不阻塞
+            size_t pickRoundRobin(const HostCandidates &candidates)
             {
-                if(_host.empty()) return HostDetail();
-                auto pos = _idx++ % _host.size();
-                if (_idx >= MAX_IDX) _idx%=_host.size();//防止索引溢出
-                return _host[pos];
+                uint64_t pos = _idx.fetch_add(1, std::memory_order_relaxed);
+                return candidates[pos % candidates.size()];
             }
             //随机算法选择主机
-            HostDetail pickRandom() 
+            size_t pickRandom(const HostCandidates &candidates)
             {
-                if (_host.empty()) return HostDetail();
-                std::uniform_int_distribution<size_t> dist(0, _host.size() - 1);
-                auto pos = dist(_rng);
-                return _host[pos];
+                std::uniform_int_distribution<size_t> dist(0, candidates.size() - 1);
+                return candidates[dist(rng())];
             }
-            //源地址hash算法选择主机
-            HostDetail pickSourceHash(const std::string &key) {
-                if(key.empty())return pickRandom();//如果key为空，则随机选择主机
-                if(_host.empty())return HostDetail();
-                size_t hash_val=_hash(key);
-                size_t pos=hash_val%_host.size();
-                return _host[pos];
+            //一致性哈希：同一个 key 总是落在同一台主机，主机增减只影响约 1/N 的 key
+            //候选集合经过过滤时，不在其中的主机被跳过，对应 key 顺延到环上的下一台
+            size_t pickSourceHash(const HostSnapshot &cur, const HostCandidates &candidates, const std::string &key) {
+                if(key.empty())return pickRandom(candidates);//如果key为空，则随机选择主机
+                auto accept = [&](const HostInfo &host) {
+                    if (candidates.idx == nullptr) return true;//未过滤时环上的主机都可选
+                    for (size_t i = 0; i < candidates.size(); ++i)
+                    {
+                        if (cur.hosts[candidates[i]].host == host) return true;
+                    }
+                    return false;
+                };
+                HostInfo target;
+                if (!cur.ring.locate(key, accept, target)) return pickRandom(candidates);
+                int pos = cur.find(target);
+                return pos >= 0 ? static_cast<size_t>(pos) : pickRandom(candidates);
             }
             //最低负载算法选择主机
-            HostDetail pickLowestLoad() {
-                if(_host.empty())return HostDetail();
-                //负载最优+轮询分配
+            size_t pickLowestLoad(const HostSnapshot &cur, const HostCandidates &candidates) {
+                //负载最优+轮询分配；负载可能被并发刷新，两轮之间读到的值不同时退回第一个候选，不影响正确性
                 int best_load = std::numeric_limits<int>::max();//初始化最佳负载为int最大值
-                std::vector<size_t> candidates;//所有负载最优的主机索引
-
-                //负载最优筛选 遍历主机列表，记录负载最小的主机索引
-                for(size_t i=0;i<_host.size();++i)
+                size_t best_count = 0;//负载最优的主机个数
+                for(size_t i=0;i<candidates.size();++i)
                 {
-                    const auto& detail=_host[i];
-                    if(detail.load<best_load)//发现更低的负载
+                    int load=cur.states[candidates[i]]->load.load(std::memory_order_relaxed);
+                    if(load<best_load)//发现更低的负载
                     {
-                        best_load=detail.load;
-                        candidates.clear();//清空候选集
-                        candidates.push_back(i);//添加当前主机索引
+                        best_load=load;
+                        best_count=1;
                     }
-                    else if(detail.load==best_load)
+                    else if(load==best_load)
                     {
-                        candidates.push_back(i);
+                        ++best_count;
                     }
                 }
-                if(candidates.empty())return HostDetail();
-                //轮询分配 配合_idx防止溢出，确保轮询顺序
-                size_t cur_pos=_idx++;
-                if(_idx>=MAX_IDX)_idx%=_host.size();
-                auto pos=candidates[cur_pos%candidates.size()];
-                return _host[pos];
+                //在负载最优的主机间轮询分配
+                uint64_t nth=_idx.fetch_add(1, std::memory_order_relaxed)%best_count;
+                for(size_t i=0;i<candidates.size();++i)
+                {
+                    if(cur.states[candidates[i]]->load.load(std::memory_order_relaxed)!=best_load)continue;
+                    if(nth==0)return candidates[i];
+                    --nth;
+                }
+                return candidates[0];
             }
-            //通过find_if+lambda判断是否存在，存在则删除
-            void removeHost(const HostInfo &host)
+            //两次随机选择：随机取两台主机，比较 客户端测得的延迟EWMA*(在途请求+1)，取较小者
+            //相比 LOWEST_LOAD 使用的上报负载，这两个输入都来自本客户端的请求完成情况，没有上报延迟
+            size_t pickP2C(const HostSnapshot &cur, const HostCandidates &candidates) {
+                if(candidates.size()==1)return candidates[0];
+                std::uniform_int_distribution<size_t> dist(0, candidates.size() - 1);
+                size_t first = dist(rng());
+                size_t second = dist(rng());
+                if (second == first) second = (first + 1) % candidates.size();//保证两台不同
+                int64_t now = nowUs();
+                size_t a = candidates[first], b = candidates[second];
+                return p2cCost(*cur.states[b], now) < p2cCost(*cur.states[a], now) ? b : a;
+            }
+            //平滑加权轮询（nginx）：每次所有候选的当前权重加上各自的有效权重，选当前权重最大者，再减去有效权重总和
+            //权重 5:1:1 的序列是 a a b a c a a 而不是 a a a a a b c，高权重主机不会连续吃到突发请求
+            //当前权重存放在主机状态中，负载刷新、主机上下线只改变之后的有效权重，不会重置分配进度
+            size_t pickWeightedRoundRobin(const HostSnapshot &cur, const HostCandidates &candidates)
             {
-                std::unique_lock<std::mutex> lock(_mutex);
-                auto it = std::find_if(
-                    _host.begin(),
-                    _host.end(),
-                    [&](const HostDetail &detail) {
-                        return detail.host == host;
-                    });
-                if (it != _host.end())
+                std::unique_lock<std::mutex> lock(_wrr_mutex);//一次选择要读改全部候选的当前权重，只有本策略使用这把锁
+                int64_t total = 0;
+                size_t best = candidates[0];
+                int64_t best_current = std::numeric_limits<int64_t>::min();
+                for (size_t i = 0; i < candidates.size(); ++i)
                 {
-                    _host.erase(it);
+                    size_t pos = candidates[i];
+                    HostState &state = *cur.states[pos];
+                    int64_t weight = effectiveWeight(cur.hosts[pos], state);
+                    state.wrr_current += weight;
+                    total += weight;
+                    if (state.wrr_current > best_current)
+                    {
+                        best_current = state.wrr_current;
+                        best = pos;
+                    }
                 }
+                cur.states[best]->wrr_current -= total;
+                return best;
             }
-            HostInfo getHost()
+            //有效权重：注册容量按上报负载（0~100）折算剩余容量，满载主机仍保留最小权重，不会完全断流
+            static int64_t effectiveWeight(const HostDetail &detail, const HostState &state)
             {
-                return selectHost(LoadBalanceStrategy::ROUND_ROBIN).host;
+                int load = std::min(std::max(state.load.load(std::memory_order_relaxed), 0), 99);
+                return static_cast<int64_t>(std::max(detail.weight, 1)) * (100 - load);
             }
-            HostDetail getHostDetail()
+            static std::mt19937 &rng()
             {
-                return selectHost(LoadBalanceStrategy::ROUND_ROBIN);
+                thread_local std::mt19937 generator(std::random_device{}());
+                return generator;
             }
-            bool empty()
+            static int64_t nowUs()
             {
-                std::unique_lock<std::mutex> lock(_mutex);
-                return _host.empty();
+                return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+            }
+            static void updateEwma(std::atomic<double> &value, double sample, bool init_with_first)
+            {
+                double cur = value.load(std::memory_order_relaxed);
+                double next;
+                do
+                {
+                    next = (init_with_first && cur <= 0) ? sample : cur * (1 - kAlpha) + sample * kAlpha;
+                } while (!value.compare_exchange_weak(cur, next, std::memory_order_relaxed));
+            }
+            static HostState::ptr newState(const HostDetail &detail)
+            {
+                auto state = std::make_shared<HostState>();
+                state->load.store(detail.load, std::memory_order_relaxed);
+                return state;
+            }
+            //hosts 与快照中的主机集合相同（忽略顺序和重复），且每台主机的权重和位置都没变
+            static bool sameHosts(const HostSnapshot &cur, const std::vector<HostDetail> &hosts)
+            {
+                std::vector<bool> seen(cur.hosts.size(), false);
+                size_t distinct = 0;
+                for (const auto &detail : hosts)
+                {
+                    int pos = cur.find(detail.host);
+                    if (pos < 0) return false;
+                    const HostDetail &old = cur.hosts[pos];
+                    if (old.weight != detail.weight || old.locality.zone != detail.locality.zone ||
+                        old.locality.rack != detail.locality.rack || old.locality.node != detail.locality.node) return false;
+                    if (!seen[pos])
+                    {
+                        seen[pos] = true;
+                        ++distinct;
+                    }
+                }
+                return distinct == cur.hosts.size();
+            }
+            HostState::ptr findState(const HostInfo &host)
+            {
+                auto snap = _snapshot.load();
+                int pos = snap->find(host);
+                return pos >= 0 ? snap->states[pos] : HostState::ptr();
+            }
+            //主机当前能否接收流量（健康，或摘除到期且没有探测在途）
+            static bool available(const HostSnapshot &cur, size_t pos, int64_t now)
+            {
+                if (!cur.policy.enable) return true;
+                const HostState &state = *cur.states[pos];
+                if (!state.ejected.load(std::memory_order_acquire)) return true;
+                if (now < state.ejected_until_us.load(std::memory_order_relaxed)) return false;
+                return !state.probing.load(std::memory_order_relaxed) || now >= state.probe_deadline_us.load(std::memory_order_relaxed);
+            }
+            //选中的主机处于半开状态时，本次请求作为探测请求
+            //并发选择时可能有极少数请求同时成为探测请求，只影响探测次数，不影响正确性
+            void markProbe(const HostSnapshot &cur, size_t pos, int64_t now)
+            {
+                HostState &state = *cur.states[pos];
+                if (!state.ejected.load(std::memory_order_acquire)) return;
+                state.probe_deadline_us.store(now + ejectDurationMs(cur.policy, state.eject_count.load(std::memory_order_relaxed)) * 1000,
+                                              std::memory_order_relaxed);
+                state.probing.store(true, std::memory_order_relaxed);
+            }
+            //P2C 代价：还没有延迟样本的主机按 1us 计，让新主机尽快得到样本；
+            //延迟样本随时间衰减，长期落选的慢主机过一段时间会重新被尝试，恢复后能拿回流量
+            static double p2cCost(const HostState &state, int64_t now)
+            {
+                double latency = state.latency_ewma_us.load(std::memory_order_relaxed);
+                int64_t update = state.latency_update_us.load(std::memory_order_relaxed);
+                if (latency > 0 && update > 0)
+                {
+                    double idle_sec = static_cast<double>(now - update) / 1000000.0;
+                    latency *= std::exp(-idle_sec / kLatencyDecaySec);
+                }
+                return std::max(latency, 1.0) * (state.inflight.load(std::memory_order_relaxed) + 1);
+            }
+            static bool tooSlow(const HealthPolicy &policy, const HostState &state)
+            {
+                return policy.latency_threshold_ms > 0 && state.latency_ewma_us.load(std::memory_order_relaxed) > policy.latency_threshold_ms * 1000.0;
+            }
+            //摘除比例上限：单台主机或已摘除过多时不再摘除
+            static bool canEject(const HostSnapshot &cur)
+            {
+                size_t ejected = 0;
+                for (const auto &state : cur.states)
+                {
+                    if (state->ejected.load(std::memory_order_relaxed)) ++ejected;
+                }
+                return static_cast<double>(ejected + 1) <= cur.policy.max_eject_percent * cur.hosts.size();
             }
+            static int64_t ejectDurationMs(const HealthPolicy &policy, int eject_count)
+            {
+                int64_t duration = policy.base_eject_ms;
+                for (int i = 1; i < eject_count && duration < policy.max_eject_ms; ++i) duration *= 2;
+                return std::min<int64_t>(duration, policy.max_eject_ms);
+            }
+            static void eject(const HealthPolicy &policy, const HostInfo &host, HostState &state, int64_t now)
+            {
+                int count = state.eject_count.fetch_add(1, std::memory_order_relaxed) + 1;
+                int64_t duration_ms = ejectDurationMs(policy, count);
+                state.ejected_until_us.store(now + duration_ms * 1000, std::memory_order_relaxed);
+                state.probing.store(false, std::memory_order_relaxed);
+                state.ejected.store(true, std::memory_order_release);
+                WLOG("[健康检查] 摘除主机 %s:%d %ldms（连续失败=%d 错误率=%.2f 延迟=%.0fus）", host.first.c_str(), host.second,
+                     static_cast<long>(duration_ms), state.consecutive_failures.load(std::memory_order_relaxed),
+                     state.error_ewma.load(std::memory_order_relaxed), state.latency_ewma_us.load(std::memory_order_relaxed));
+            }
+            static constexpr int kTierCount = 4;//就近路由的层数
+            static constexpr double kAlpha = 0.1;//EWMA 平滑系数
+            static constexpr double kLatencyDecaySec = 5.0;//延迟样本的衰减时间常数
 
-        private:
-            std::mutex _mutex;
-            uint64_t _idx;//轮询索引 类型uint64_t防止溢出
-            std::vector<HostDetail> _host;
-            std::mt19937 _rng;//随机数生成器
-            std::hash<std::string> _hash;//hash函数
-            //std::uniform_int_distribution<size_t> _dist;//随机数分布
+            std::mutex _write_mutex;//串行化快照更新，读路径不使用
+            std::mutex _eject_mutex;//串行化摘除决策，只在达到摘除阈值时使用
+            std::mutex _wrr_mutex;//串行化平滑加权轮询的选择
+            std::atomic<uint64_t> _idx;//轮询索引，64 位原子量不会溢出
+            RcuPtr<HostSnapshot> _snapshot;//当前主机列表快照
         };
         class Provider
         {
@@ -145,7 +600,9 @@ namespace lcz_rpc
             using ptr = std::shared_ptr<Provider>;
             Provider(const Requestor::ptr &requestor) : _requestor(requestor) {}
             //注册服务
-            bool methodRegistry(const BaseConnection::ptr &conn, const std::string &method, const HostInfo &host,int load)
+            //weight 为提供者的静态容量（如 CPU 核数），locality 为位置标签，注册中心原样下发给发现者做加权轮询/就近路由
+            bool methodRegistry(const BaseConnection::ptr &conn, const std::string &method, const HostInfo &host,int load,int weight = 1,
+                                const Locality &locality = Locality())
             {
                 auto msg_req = MessageFactory::create<ServiceRequest>();
                 msg_req->setId(uuid());
@@ -154,6 +611,8 @@ namespace lcz_rpc
                 msg_req->setHost(host);
                 msg_req->setOptype(ServiceOpType::REGISTER);
                 msg_req->setLoad(load);
+                msg_req->setWeight(weight);
+                msg_req->setLocality(locality);
                 BaseMessage::ptr msg_resp;
                 DLOG("methodRegistry send begin:%s -> %s:%d", method.c_str(), host.first.c_str(), host.second);
                 bool ret = _requestor->send(conn, msg_req, msg_resp);
@@ -240,7 +699,14 @@ namespace lcz_rpc
         public:
             using ptr = std::shared_ptr<Discover>;
             using OfflineCallback=std::function<void(const HostInfo&)>;
+            using UpdateCallback=std::function<void(const std::string&)>;//某个方法的主机列表发生变化
             Discover(const Requestor::ptr &requestor,const OfflineCallback& cb) : _requestor(requestor),_offline_cb(cb) {}
+            //主机列表变化通知（上线/下线/刷新），供上层让按方法缓存的路由失效
+            void setUpdateCallback(const UpdateCallback &cb)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _update_cb = cb;
+            }
             void onserviceRequest(const BaseConnection::ptr &conn,const ServiceRequest::ptr &req)
             {
                 std::unique_lock<std::mutex> lock(_mutex);
@@ -249,26 +715,29 @@ namespace lcz_rpc
                 auto type = req->optype();
                 if (type == ServiceOpType::ONLINE)
                 {
-                    auto it = _method_host.find(req->method());
-                    if (it != _method_host.end())
+                    MethodHost::ptr method_host = findMethod(method);
+                    HostDetail detail(req->host(), req->load(), req->weight());//上线通知携带注册时的负载、容量权重和位置标签
+                    detail.locality = req->locality();
+                    if (method_host)
                     {
-                        
-                       // TODO: 这里后续上线通知要带负载，现在还没有就先传 0
-                       it->second->appendHost(req->host(), 0);
+                        method_host->appendHost(detail);
                     }
                     else
                     {
-                        auto method_host=std::make_shared<MethodHost>();
-                        method_host->appendHost(req->host(), 0);
-                        _method_host[method]=method_host;
+                        method_host = newMethodHost();
+                        method_host->appendHost(detail);
+                        publishMethod(method, method_host);
                     }
+                    if (_update_cb) _update_cb(method);
                 }
                 else if (type == ServiceOpType::OFFLINE)
                 {
-                    auto it = _method_host.find(req->method());
-                    if (it != _method_host.end())
+                    auto methods = _method_host.load();
+                    auto it = methods->find(req->method());
+                    if (it != methods->end())
                     {
                         it->second->removeHost(req->host());
+                        if (_update_cb) _update_cb(method);
                         _offline_cb(req->host());//删除连接池的连接
                     }
                     else
@@ -281,20 +750,23 @@ namespace lcz_rpc
                     return;
                 }
             }
+            //exclude 非空时在缓存中挑选另一台主机，没有其他主机则返回 false；hash_key 供 SOURCE_HASH 使用
             bool serviceDiscover(const BaseConnection::ptr &conn,
                                  const std::string &method,
                                  HostDetail &detail,
                                  LoadBalanceStrategy strategy,
-                                 bool force_remote = false)
+                                 bool force_remote = false,
+                                 const HostInfo &exclude = HostInfo(),
+                                 const std::string &hash_key = std::string())
             {
                 if (!force_remote)
                 {
-                    std::unique_lock<std::mutex> lock(_mutex);
-                    auto it = _method_host.find(method);
-                    if (it != _method_host.end())
+                    MethodHost::ptr method_host = findMethod(method);//读快照，不加锁
+                    if (method_host)
                     {
-                        detail = it->second->selectHost(strategy);
-                        ILOG("[discover-cache] method=%s strategy=%d host=%s:%d load=%d",
+                        detail = method_host->selectHost(strategy, hash_key, exclude);
+                        if (!exclude.first.empty()) return !detail.host.first.empty();
+                        DLOG("[discover-cache] method=%s strategy=%d host=%s:%d load=%d",
                             method.c_str(),
                             static_cast<int>(strategy),
                             detail.host.first.c_str(),
@@ -331,12 +803,11 @@ namespace lcz_rpc
                 auto details = service_resp->hostsDetail(); // 注意这里
                  if (details.empty()) { ELOG("服务发现失败，没有提供 %s 服务的主机", method.c_str()); return false; }
                  
-                 auto method_host = std::make_shared<MethodHost>();
-                 for (const auto &detail : details) {
-                     method_host->appendHost(detail.host, detail.load);
-                 }
-                 detail=method_host->selectHost(strategy);
-                 _method_host[method]=method_host; // 缓存新获取的主机列表以供后续复用
+                 bool created = false;
+                 MethodHost::ptr method_host = applyHosts(method, details, created);
+                 //并入已有缓存或新建都走同一套选择：摘除过滤、负载均衡策略、一致性哈希、就近分层与 exclude 都生效
+                 detail = method_host->selectHost(strategy, hash_key, exclude);
+                 if (detail.host.first.empty()) return false;//只有被排除的主机
                  ILOG("[discover-cache] method=%s host=%s:%d load=%d",
                     method.c_str(),
                     detail.host.first.c_str(),
@@ -344,10 +815,117 @@ namespace lcz_rpc
                     detail.load);
                  return true;
             }
+            //批量服务发现：一次请求发现多个方法并写入缓存，返回有提供者的方法
+            std::vector<std::string> serviceDiscoverBatch(const BaseConnection::ptr &conn, const std::vector<std::string> &methods)
+            {
+                std::vector<std::string> found;
+                if (methods.empty()) return found;
+                auto msg_req = MessageFactory::create<ServiceRequest>();
+                msg_req->setId(uuid());
+                msg_req->setMethod(std::string());
+                msg_req->setMethods(methods);
+                msg_req->setMsgType(MsgType::REQ_SERVICE);
+                msg_req->setOptype(ServiceOpType::DISCOVER_BATCH);
+                BaseMessage::ptr msg_resp;
+                if (!_requestor->send(conn, msg_req, msg_resp))
+                {
+                    ELOG("批量服务发现失败：%zu 个方法", methods.size());
+                    return found;
+                }
+                auto service_resp = std::dynamic_pointer_cast<ServiceResponse>(msg_resp);
+                if (service_resp.get() == nullptr)
+                {
+                    ELOG("向下转换失败");
+                    return found;
+                }
+                if (service_resp->rcode() != RespCode::SUCCESS)
+                {
+                    ELOG("批量服务发现失败:%s", errReason(service_resp->rcode()).c_str());
+                    return found;
+                }
+                for (auto &item : service_resp->methodHostsDetail())
+                {
+                    if (item.second.empty()) continue;
+                    bool created = false;
+                    applyHosts(item.first, item.second, created);
+                    found.push_back(item.first);
+                }
+                return found;
+            }
+            void setHealthPolicy(const HealthPolicy &policy)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _health_policy = policy;
+                for (auto &item : *_method_host.load()) item.second->setHealthPolicy(policy);
+            }
+            //客户端自身的位置标签，已缓存和之后发现的方法都按它就近路由
+            void setLocality(const Locality &self, const LocalityPolicy &policy)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _locality = self;
+                _locality_policy = policy;
+                for (auto &item : *_method_host.load()) item.second->setLocality(self, policy);
+            }
+            //调用结果反馈给对应方法的主机列表，成功与否按 MethodHost::healthyResponse 判定
+            void onResult(const std::string &method, const HostInfo &host, RespCode rcode, int64_t latency_us)
+            {
+                MethodHost::ptr method_host = findMethod(method);
+                if (!method_host) return;
+                method_host->onResult(host, MethodHost::healthyResponse(rcode), latency_us);
+            }
+            void onSend(const std::string &method, const HostInfo &host)
+            {
+                MethodHost::ptr method_host = findMethod(method);
+                if (method_host) method_host->onSend(host);
+            }
+            //已缓存的方法主机列表，不存在时返回空（不会触发远程发现）
+            MethodHost::ptr findMethod(const std::string &method) const
+            {
+                auto methods = _method_host.load();
+                auto it = methods->find(method);
+                return it == methods->end() ? MethodHost::ptr() : it->second;
+            }
         private:
-            std::mutex _mutex;
+            using MethodMap = std::unordered_map<std::string, MethodHost::ptr>;
+            //把注册中心返回的主机列表写入缓存：已缓存的方法原地更新（保留健康状态和负载均衡进度），否则新建并发布
+            MethodHost::ptr applyHosts(const std::string &method, const std::vector<HostDetail> &details, bool &created)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                MethodHost::ptr method_host = findMethod(method);
+                created = method_host.get() == nullptr;
+                if (!created)
+                {
+                    //只有主机集合、权重或位置变化时才让上层路由失效；负载变化直接写进共享的主机状态
+                    if (method_host->updateHosts(details) && _update_cb) _update_cb(method);
+                    return method_host;
+                }
+                method_host = newMethodHost();
+                method_host->updateHosts(details);
+                publishMethod(method, method_host); // 缓存新获取的主机列表以供后续复用
+                return method_host;
+            }
+            //调用方持有 _mutex：新方法继承当前的健康检查和就近路由配置
+            MethodHost::ptr newMethodHost() const
+            {
+                auto method_host = std::make_shared<MethodHost>();
+                method_host->setHealthPolicy(_health_policy);
+                if (!_locality.empty()) method_host->setLocality(_locality, _locality_policy);
+                return method_host;
+            }
+            //调用方持有 _mutex：复制方法表加入新方法后原子替换（新方法出现的频率很低）
+            void publishMethod(const std::string &method, const MethodHost::ptr &method_host)
+            {
+                auto next = std::make_shared<MethodMap>(*_method_host.load());
+                (*next)[method] = method_host;
+                _method_host.store(std::move(next));
+            }
+            std::mutex _mutex;//串行化方法表更新，查找路径读快照不加锁
             OfflineCallback _offline_cb;
-            std::unordered_map<std::string, MethodHost::ptr> _method_host;
+            UpdateCallback _update_cb;
+            HealthPolicy _health_policy;
+            Locality _locality;
+            LocalityPolicy _locality_policy;
+            RcuPtr<MethodMap> _method_host;
             Requestor::ptr _requestor;
         };
     }
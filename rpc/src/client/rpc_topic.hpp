@@ -3,6 +3,7 @@
 #include "caller.hpp"
 #include "rpc_registry.hpp"
 #include "../server/rpc_topic.hpp"
+#include "../general/executor.hpp"
 #include "../general/publicconfig.hpp"
 
 namespace lcz_rpc
@@ -15,6 +16,12 @@ namespace lcz_rpc
             using SubCallback = std::function<void(const std::string &, const std::string &)>;//消息推送调用的回调
             using ptr = std::shared_ptr<TopicManager>;
             TopicManager(const Requestor::ptr &requestor) : _requestor(requestor) {}
+            //订阅回调的执行器：为空时在 I/O 线程上直接执行；同一主题的消息固定投递到同一线程，保持发布顺序
+            void setExecutor(const Executor::ptr &executor)
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _executor = executor;
+            }
             bool createTopic(const BaseConnection::ptr &conn, const std::string &topic_name) { return commonRequest(conn, topic_name, TopicOpType::CREATE); }
             bool removeTopic(const BaseConnection::ptr &conn, const std::string &topic_name) { return commonRequest(conn, topic_name, TopicOpType::REMOVE); }
             bool subscribeTopic(const BaseConnection::ptr &conn, const std::string &topic_name, const SubCallback &cb,int priority=0,const std::vector<std::string> &tags={})
@@ -48,7 +55,15 @@ namespace lcz_rpc
                     ELOG("接收到主题 %s 消息，但是没有对应回调",topic_name.c_str());
                     return;
                 }
-                return pub_callback(topic_name,topic_msg);
+                Executor::ptr executor;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    executor=_executor;
+                }
+                if(!executor)return pub_callback(topic_name,topic_msg);
+                executor->post(std::hash<std::string>()(topic_name),[pub_callback,topic_name,topic_msg]{
+                    pub_callback(topic_name,topic_msg);
+                });
             }
 
         private:
@@ -123,6 +138,7 @@ namespace lcz_rpc
         private:
             std::mutex _mutex;
             std::unordered_map<std::string, SubCallback> _topic_cb;//保存一个主题对应的回调
+            Executor::ptr _executor;//订阅回调执行器
             Requestor::ptr _requestor; // 对请求发送，响应的接收处理
         };
 
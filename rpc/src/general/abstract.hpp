@@ -1,6 +1,8 @@
 #pragma once
 #include <memory>
 #include <functional>
+#include <vector>
+#include <atomic>
 #include "fields.hpp"
 #include "publicconfig.hpp"
 namespace lcz_rpc {
@@ -17,6 +19,10 @@ namespace lcz_rpc {
         virtual void setMsgType(MsgType msgtype) {_msgtype = msgtype;}
         // 获取消息类型
         virtual MsgType msgType() { return _msgtype; }
+        // 设置方法 ID：设置后由协议层写入帧头，消息体不再携带方法名
+        virtual void setMethodId(MethodId id) {_method_id = id;}
+        // 获取方法 ID，未设置时为 kInvalidMethodId
+        virtual MethodId methodId() { return _method_id; }
         // 序列化消息
         virtual std::string serialize() = 0;
         // 反序列化消息
@@ -26,6 +32,7 @@ namespace lcz_rpc {
     private:
         MsgType _msgtype;        // 消息类型
         std::string _rid;        // 消息ID
+        MethodId _method_id = kInvalidMethodId;  // 帧头携带的方法 ID
     };
 
     // 缓冲区基类
@@ -62,10 +69,28 @@ namespace lcz_rpc {
         using ptr = std::shared_ptr<BaseConnection>;
         // 发送消息
         virtual void send(const BaseMessage::ptr &msg) = 0;
+        // 批量发送消息：默认逐条发送，具体实现可以合并成一次写
+        virtual void send(const std::vector<BaseMessage::ptr> &msgs)
+        {
+            for (auto &msg : msgs) send(msg);
+        }
         // 关闭连接
         virtual void shutdown() = 0;
         // 检查连接状态
         virtual bool connected() = 0;
+        // 对端服务端的方法 ID 表：握手完成后设置一次，之后只读；未握手或对端不支持时为空
+        // 表随连接存在，断线重连得到新的连接对象，不会沿用重启前服务端分配的 ID
+        const MethodIdTable* methodIds() const { return _method_ids.load(std::memory_order_acquire); }
+        bool setMethodIds(const std::shared_ptr<const MethodIdTable> &ids)
+        {
+            const MethodIdTable* expected = nullptr;
+            if (!_method_ids.compare_exchange_strong(expected, ids.get(), std::memory_order_acq_rel)) return false;
+            _method_ids_owner = ids;// 只有第一次设置生效，持有者只会被写一次
+            return true;
+        }
+    private:
+        std::atomic<const MethodIdTable*> _method_ids{nullptr};
+        std::shared_ptr<const MethodIdTable> _method_ids_owner;
     };
 
     // 连接建立回调
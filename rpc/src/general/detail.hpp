@@ -71,20 +71,19 @@ class JSON{
 // 简单的 uuid 生成工具：前半随机数，后半自增序号
 std::string uuid() {
     std::stringstream ss;
-    //1. 构造⼀个机器随机数对象
-    std::random_device rd;
-    //2. 以机器随机数为种⼦构造伪随机数对象
-    std::mt19937 generator (rd());
-    //3. 构造限定数据范围的对象
+    //1. 以机器随机数为种⼦构造伪随机数对象，每个线程只播种一次
+    //   （每次都构造 random_device 会在热路径上多一次系统调用）
+    thread_local std::mt19937 generator(std::random_device{}());
+    //2. 构造限定数据范围的对象
     std::uniform_int_distribution<int> distribution(0, 255);
-    //4. ⽣成8个随机数，按照特定格式组织成为16进制数字字符的字符串
+    //3. ⽣成8个随机数，按照特定格式组织成为16进制数字字符的字符串
     for (int i = 0; i < 8; i++) {
         if (i == 4 || i == 6) ss << "-";
         ss << std::setw(2) << std::setfill('0') <<std::hex <<
         distribution(generator);
     }
     ss << "-";
-    //5. 定义⼀个8字节序号，逐字节组织成为16进制数字字符的字符串
+    //4. 定义⼀个8字节序号，逐字节组织成为16进制数字字符的字符串
     static std::atomic<size_t> seq(1); // 00 00 00 00 00 00 00 01
     size_t cur = seq.fetch_add(1);
     for (int i = 7; i >= 0; i--) {
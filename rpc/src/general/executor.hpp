@@ -0,0 +1,442 @@
+#pragma once
+/*回调执行器：决定用户回调在哪个线程上执行
+InlineExecutor：在调用线程（通常是 I/O 线程）上直接执行，零开销，回调必须很快
+ThreadPoolExecutor：固定线程池，每个工作线程一条队列；带 key 提交的任务按 key 固定到同一线程，保证同 key 有序
+WorkStealingExecutor：每个工作线程一条无锁环形队列，提交方投递到亲和的工作线程，空闲线程从其他队列窃取；不带 key 的任务不保证顺序，带 key 的任务同 key 有序
+FunctionExecutor：包装用户提供的投递函数，接入已有的线程池/事件循环
+*/
+#include <functional>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+
+namespace lcz_rpc
+{
+    class Executor
+    {
+    public:
+        using ptr = std::shared_ptr<Executor>;
+        using Task = std::function<void()>;
+        virtual ~Executor() = default;
+        // 提交任务，不保证与其他任务的先后顺序
+        virtual void post(Task task) = 0;
+        // 按 key 提交：只有覆盖了该函数的执行器才保证同一个 key 的任务按提交顺序执行，默认实现忽略 key，与 post(task) 相同
+        virtual void post(size_t /*key*/, Task task) { post(std::move(task)); }
+    };
+
+    class InlineExecutor : public Executor
+    {
+    public:
+        using Executor::post;
+        void post(Task task) override { task(); }
+    };
+
+    class ThreadPoolExecutor : public Executor
+    {
+    public:
+        using ptr = std::shared_ptr<ThreadPoolExecutor>;
+        ThreadPoolExecutor(size_t threads = std::max<size_t>(std::thread::hardware_concurrency(), 1))
+            : _workers(std::max<size_t>(threads, 1))
+        {
+            for (auto &worker : _workers)
+            {
+                worker.thread = std::thread([&worker] { run(worker); });
+            }
+        }
+        // 析构时执行完已提交的任务再退出
+        ~ThreadPoolExecutor() override
+        {
+            for (auto &worker : _workers)
+            {
+                std::unique_lock<std::mutex> lock(worker.mutex);
+                worker.stop = true;
+                worker.cond.notify_one();
+            }
+            for (auto &worker : _workers)
+            {
+                if (worker.thread.joinable()) worker.thread.join();
+            }
+        }
+        void post(Task task) override
+        {
+            push(_next.fetch_add(1, std::memory_order_relaxed), std::move(task));
+        }
+        void post(size_t key, Task task) override { push(key, std::move(task)); }
+        size_t size() const { return _workers.size(); }
+
+    private:
+        struct Worker
+        {
+            std::mutex mutex;
+            std::condition_variable cond;
+            std::deque<Task> tasks;
+            bool stop = false;
+            std::thread thread;
+        };
+        void push(size_t key, Task task)
+        {
+            Worker &worker = _workers[key % _workers.size()];
+            {
+                std::unique_lock<std::mutex> lock(worker.mutex);
+                worker.tasks.push_back(std::move(task));
+            }
+            worker.cond.notify_one();
+        }
+        static void run(Worker &worker)
+        {
+            while (true)
+            {
+                Task task;
+                {
+                    std::unique_lock<std::mutex> lock(worker.mutex);
+                    worker.cond.wait(lock, [&worker] { return worker.stop || !worker.tasks.empty(); });
+                    if (worker.tasks.empty()) return;// stop 且队列已清空
+                    task = std::move(worker.tasks.front());
+                    worker.tasks.pop_front();
+                }
+                task();
+            }
+        }
+        std::vector<Worker> _workers;
+        std::atomic<size_t> _next{0};
+    };
+
+    // 工作窃取线程池：服务端执行线程池的默认实现
+    // 每个工作线程一条有界无锁 MPMC 环形队列（Vyukov 算法）：提交方（I/O 线程）按线程亲和投递到固定的工作线程，
+    // 工作线程先取自己的队列，空了再依次从其他队列窃取；全部为空时才在条件变量上休眠，提交方只在有休眠线程时加锁唤醒
+    // 队列满时落到一条加锁的溢出队列，只在突发积压时使用
+    // 带 key 的任务进入 key 对应工作线程的专属队列（加锁、不参与窃取），只由该线程按提交顺序执行，保证同 key 有序
+    class WorkStealingExecutor : public Executor
+    {
+    public:
+        using ptr = std::shared_ptr<WorkStealingExecutor>;
+        struct Stats
+        {
+            size_t queued = 0;        // 当前排队的任务数（近似值）
+            uint64_t executed = 0;    // 已执行的任务数
+            uint64_t steals = 0;      // 从其他工作线程队列窃取的任务数
+            uint64_t overflows = 0;   // 环形队列满、落到溢出队列的任务数
+            double avg_wait_us = 0;   // 从提交到开始执行的平均等待时间
+            int64_t max_wait_us = 0;  // 最大等待时间
+        };
+        // capacity 为每个工作线程环形队列的容量，向上取整到 2 的幂
+        WorkStealingExecutor(size_t threads = std::max<size_t>(std::thread::hardware_concurrency(), 1), size_t capacity = 4096)
+        {
+            threads = std::max<size_t>(threads, 1);
+            size_t cap = 2;
+            while (cap < capacity) cap <<= 1;
+            for (size_t i = 0; i < threads; ++i) _rings.emplace_back(new TaskRing(cap));
+            for (size_t i = 0; i < threads; ++i) _keyed.emplace_back(new KeyedQueue());
+            _conds.reset(new std::condition_variable[threads]);
+            _sleeping.assign(threads, false);
+            for (size_t i = 0; i < threads; ++i) _threads.emplace_back([this, i] { run(i); });
+        }
+        // 析构时执行完已提交的任务再退出
+        ~WorkStealingExecutor() override
+        {
+            {
+                std::unique_lock<std::mutex> lock(_sleep_mutex);
+                _stop = true;
+            }
+            for (size_t i = 0; i < _rings.size(); ++i) _conds[i].notify_all();
+            for (auto &thread : _threads)
+            {
+                if (thread.joinable()) thread.join();
+            }
+        }
+        // 工作线程内提交的任务放回本线程的队列，其他线程按线程 id 固定亲和到一个工作线程
+        void post(Task task) override
+        {
+            size_t index = current() == this ? currentIndex() : affinity();
+            push(index, std::move(task));
+        }
+        // 同 key 的任务固定由一个工作线程按提交顺序执行，不会被其他线程窃取
+        void post(size_t key, Task task) override
+        {
+            size_t index = key % _rings.size();
+            Item item;
+            item.task = std::move(task);
+            item.enqueue_us = nowUs();
+            {
+                std::unique_lock<std::mutex> lock(_keyed[index]->mutex);
+                _keyed[index]->items.push_back(std::move(item));
+            }
+            wake(index, true);
+        }
+        size_t size() const { return _rings.size(); }
+        Stats stats() const
+        {
+            Stats st;
+            for (const auto &ring : _rings) st.queued += ring->size();
+            for (const auto &keyed : _keyed)
+            {
+                std::unique_lock<std::mutex> lock(keyed->mutex);
+                st.queued += keyed->items.size();
+            }
+            {
+                std::unique_lock<std::mutex> lock(_overflow_mutex);
+                st.queued += _overflow.size();
+            }
+            st.executed = _executed.load(std::memory_order_relaxed);
+            st.steals = _steals.load(std::memory_order_relaxed);
+            st.overflows = _overflows.load(std::memory_order_relaxed);
+            st.avg_wait_us = st.executed ? static_cast<double>(_wait_total_us.load(std::memory_order_relaxed)) / st.executed : 0;
+            st.max_wait_us = _max_wait_us.load(std::memory_order_relaxed);
+            return st;
+        }
+
+    private:
+        struct Item
+        {
+            Task task;
+            int64_t enqueue_us = 0;
+        };
+        // 有界 MPMC 环形队列：每个槽位的序号表明它当前可写（== pos）还是可读（== pos + 1），push/pop 各只需一次 CAS
+        class TaskRing
+        {
+        public:
+            explicit TaskRing(size_t capacity) : _cells(new Cell[capacity]), _mask(capacity - 1)
+            {
+                for (size_t i = 0; i < capacity; ++i) _cells[i].seq.store(i, std::memory_order_relaxed);
+            }
+            bool push(Item &item)
+            {
+                size_t pos = _enqueue.load(std::memory_order_relaxed);
+                Cell *cell;
+                while (true)
+                {
+                    cell = &_cells[pos & _mask];
+                    size_t seq = cell->seq.load(std::memory_order_acquire);
+                    intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+                    if (diff == 0)
+                    {
+                        if (_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+                    }
+                    else if (diff < 0) return false;// 队列已满
+                    else pos = _enqueue.load(std::memory_order_relaxed);
+                }
+                cell->item = std::move(item);
+                cell->seq.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+            bool pop(Item &item)
+            {
+                size_t pos = _dequeue.load(std::memory_order_relaxed);
+                Cell *cell;
+                while (true)
+                {
+                    cell = &_cells[pos & _mask];
+                    size_t seq = cell->seq.load(std::memory_order_acquire);
+                    intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+                    if (diff == 0)
+                    {
+                        if (_dequeue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+                    }
+                    else if (diff < 0) return false;// 队列为空
+                    else pos = _dequeue.load(std::memory_order_relaxed);
+                }
+                item = std::move(cell->item);
+                cell->item.task = nullptr;// 及时释放任务捕获的对象
+                cell->seq.store(pos + _mask + 1, std::memory_order_release);
+                return true;
+            }
+            size_t size() const
+            {
+                size_t enqueue = _enqueue.load(std::memory_order_relaxed);
+                size_t dequeue = _dequeue.load(std::memory_order_relaxed);
+                return enqueue > dequeue ? enqueue - dequeue : 0;
+            }
+
+        private:
+            struct Cell
+            {
+                std::atomic<size_t> seq;
+                Item item;
+            };
+            std::unique_ptr<Cell[]> _cells;
+            size_t _mask;
+            alignas(64) std::atomic<size_t> _enqueue{0};// 生产端和消费端的游标分开缓存行，避免互相失效
+            alignas(64) std::atomic<size_t> _dequeue{0};
+        };
+        // 带 key 任务的专属队列：只有所属工作线程会取
+        struct KeyedQueue
+        {
+            std::mutex mutex;
+            std::deque<Item> items;
+        };
+        static int64_t nowUs()
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+        // 当前线程所属的工作窃取线程池及下标，非工作线程为空
+        static WorkStealingExecutor *&current()
+        {
+            thread_local WorkStealingExecutor *executor = nullptr;
+            return executor;
+        }
+        static size_t &currentIndex()
+        {
+            thread_local size_t index = 0;
+            return index;
+        }
+        size_t affinity() const
+        {
+            thread_local size_t hash = std::hash<std::thread::id>{}(std::this_thread::get_id());
+            return hash % _rings.size();
+        }
+        void push(size_t index, Task task)
+        {
+            Item item;
+            item.task = std::move(task);
+            item.enqueue_us = nowUs();
+            if (!pushAny(index, item))
+            {
+                std::unique_lock<std::mutex> lock(_overflow_mutex);
+                _overflow.push_back(std::move(item));
+                _overflows.fetch_add(1, std::memory_order_relaxed);
+            }
+            wake(index, false);
+        }
+        // 唤醒一个休眠的工作线程：only_index 为 true 时只唤醒 index（专属队列的任务别的线程取不到），否则优先 index
+        void wake(size_t index, bool only_index)
+        {
+            // 与休眠方的 fence 配对：要么这里看到休眠线程并唤醒，要么休眠方在入睡前的复查中看到新任务
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (_sleepers.load(std::memory_order_relaxed) == 0) return;
+            std::unique_lock<std::mutex> lock(_sleep_mutex);
+            size_t n = only_index ? 1 : _rings.size();
+            for (size_t i = 0; i < n; ++i)
+            {
+                size_t target = (index + i) % _rings.size();
+                if (!_sleeping[target]) continue;
+                _sleeping[target] = false;// 由唤醒方清除，下一次提交会挑另一个休眠线程
+                _conds[target].notify_one();
+                return;
+            }
+        }
+        // 亲和队列满时依次尝试其他工作线程的队列，全部满才落到溢出队列
+        bool pushAny(size_t index, Item &item)
+        {
+            for (size_t i = 0; i < _rings.size(); ++i)
+            {
+                if (_rings[(index + i) % _rings.size()]->push(item)) return true;
+            }
+            return false;
+        }
+        // 取任务：自己的专属队列 -> 自己的队列 -> 溢出队列 -> 依次窃取其他工作线程的队列（专属队列不参与窃取）
+        bool take(size_t index, Item &item)
+        {
+            {
+                KeyedQueue &keyed = *_keyed[index];
+                std::unique_lock<std::mutex> lock(keyed.mutex);
+                if (!keyed.items.empty())
+                {
+                    item = std::move(keyed.items.front());
+                    keyed.items.pop_front();
+                    return true;
+                }
+            }
+            if (_rings[index]->pop(item)) return true;
+            {
+                std::unique_lock<std::mutex> lock(_overflow_mutex);
+                if (!_overflow.empty())
+                {
+                    item = std::move(_overflow.front());
+                    _overflow.pop_front();
+                    return true;
+                }
+            }
+            for (size_t i = 1; i < _rings.size(); ++i)
+            {
+                if (_rings[(index + i) % _rings.size()]->pop(item))
+                {
+                    _steals.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+            }
+            return false;
+        }
+        void execute(Item &item)
+        {
+            int64_t wait = std::max<int64_t>(nowUs() - item.enqueue_us, 0);
+            _wait_total_us.fetch_add(wait, std::memory_order_relaxed);
+            int64_t max = _max_wait_us.load(std::memory_order_relaxed);
+            while (wait > max && !_max_wait_us.compare_exchange_weak(max, wait, std::memory_order_relaxed)) {}
+            item.task();
+            item.task = nullptr;
+            _executed.fetch_add(1, std::memory_order_relaxed);
+        }
+        void run(size_t index)
+        {
+            current() = this;
+            currentIndex() = index;
+            Item item;
+            while (true)
+            {
+                bool found = take(index, item);
+                for (int i = 0; !found && i < kSpin; ++i)// 短暂让出 CPU 再找，突发流量下避免频繁进出休眠
+                {
+                    std::this_thread::yield();
+                    found = take(index, item);
+                }
+                if (!found)
+                {
+                    std::unique_lock<std::mutex> lock(_sleep_mutex);
+                    _sleepers.fetch_add(1, std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    found = take(index, item);// 入睡前复查，防止错过登记休眠之前提交的任务
+                    if (!found)
+                    {
+                        if (_stop)
+                        {
+                            _sleepers.fetch_sub(1, std::memory_order_relaxed);
+                            return;// stop 且队列已清空
+                        }
+                        _sleeping[index] = true;
+                        _conds[index].wait(lock, [this, index] { return !_sleeping[index] || _stop; });
+                        _sleeping[index] = false;
+                    }
+                    _sleepers.fetch_sub(1, std::memory_order_relaxed);
+                    if (!found) continue;
+                }
+                execute(item);
+            }
+        }
+        static constexpr int kSpin = 16;
+
+        std::vector<std::unique_ptr<TaskRing>> _rings;
+        mutable std::mutex _overflow_mutex;
+        std::deque<Item> _overflow;
+        std::vector<std::unique_ptr<KeyedQueue>> _keyed;// 与 _rings 一一对应
+        std::mutex _sleep_mutex;
+        std::unique_ptr<std::condition_variable[]> _conds;// 每个工作线程一个，唤醒指定的线程
+        std::vector<bool> _sleeping;// 由 _sleep_mutex 保护
+        std::atomic<int> _sleepers{0};
+        bool _stop = false;// 由 _sleep_mutex 保护
+        std::atomic<uint64_t> _executed{0};
+        std::atomic<uint64_t> _steals{0};
+        std::atomic<uint64_t> _overflows{0};
+        std::atomic<int64_t> _wait_total_us{0};
+        std::atomic<int64_t> _max_wait_us{0};
+        std::vector<std::thread> _threads;// 最后声明：线程启动时其余成员都已构造完成
+    };
+
+    // 用户提供的投递函数：是否按 key 有序取决于用户的实现，这里不做保证
+    class FunctionExecutor : public Executor
+    {
+    public:
+        using PostFunction = std::function<void(Task)>;
+        FunctionExecutor(PostFunction post_fn) : _post(std::move(post_fn)) {}
+        using Executor::post;
+        void post(Task task) override { _post(std::move(task)); }
+
+    private:
+        PostFunction _post;
+    };
+}
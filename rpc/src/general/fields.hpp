@@ -18,6 +18,17 @@ namespace lcz_rpc{
 #define KEY_RCODE "rcode"
 #define KEY_RESULT "result"
 #define KEY_LOAD "load"//携带负载信息
+#define KEY_WEIGHT "weight"//提供者注册的静态容量权重
+#define KEY_LOCALITY "locality"//位置标签对象：zone/rack/node
+#define KEY_ZONE "zone"
+#define KEY_RACK "rack"
+#define KEY_NODE "node"
+#define KEY_METHODS "methods"//批量服务发现：请求中为方法名数组，响应中为 方法名->主机数组
+
+// 内置方法：服务端不经过注册表直接应答，客户端预热时用作空操作探测
+#define METHOD_PING "rpc.ping"
+// 内置方法：返回 方法名->方法 ID，客户端建立连接后据此握手，之后的请求在帧头携带 ID 而不是方法名
+#define METHOD_LIST "rpc.methods"
 
 // Topic 消息需要的扩展字段
 #define KEY_TOPIC_FORWARD    "forward_strategy"  // 当前使用的转发策略
@@ -48,7 +59,8 @@ enum class RespCode {
     SERVICE_NOT_FOUND,          // 没有找到对应的服务
     INVALID_OPTYPE,             // 无效的操作类型
     TOPIC_NOT_FOUND,            // 没有找到对应的主题
-    INTERNAL_ERROR              // 内部错误
+    INTERNAL_ERROR,             // 内部错误
+    OVERLOADED                  // 过载，请求未被处理（可换一台重试）
 };
 //错误原因
 static std::string errReason(RespCode code) {
@@ -62,7 +74,8 @@ static std::string errReason(RespCode code) {
         {RespCode::SERVICE_NOT_FOUND, "没有找到对应的服务!"},
         {RespCode::INVALID_OPTYPE, "无效的操作类型"},
         {RespCode::TOPIC_NOT_FOUND, "没有找到对应的主题!"},
-        {RespCode::INTERNAL_ERROR, "内部错误!"}
+        {RespCode::INTERNAL_ERROR, "内部错误!"},
+        {RespCode::OVERLOADED, "过载，请求被拒绝!"}
     };
     auto it = err_map.find(code);
     if (it == err_map.end()) {return "未知错误！";}
@@ -101,7 +114,8 @@ enum class ServiceOpType {
     OFFLINE,        // 服务下线
     LOAD_REPORT,    // 服务负载上报
     HEARTBEAT_PROVIDER,   // 提供者心跳：证明“我能服务”
-    UNKNOWN         // 未知操作
+    UNKNOWN,        // 未知操作
+    DISCOVER_BATCH  // 批量服务发现：一次请求发现多个方法（追加在末尾，已有取值不变）
 };
 
 // 负载均衡类型定义
@@ -110,7 +124,9 @@ enum class LoadBalanceStrategy
     ROUND_ROBIN,//轮询
     RANDOM,//随机
     SOURCE_HASH,//源地址hash
-    LOWEST_LOAD//最低负载
+    LOWEST_LOAD,//最低负载
+    P2C_LATENCY,//随机取两台，选 延迟EWMA*(在途请求+1) 较小者
+    WEIGHTED_ROUND_ROBIN//平滑加权轮询，权重=注册容量*(100-上报负载)
 };//负载均衡类型
 
 enum class SerializationMethod
@@ -0,0 +1,229 @@
+#pragma once
+/*轻量级可组合 future/promise
+共享状态：Promise 与 Future 共用一块状态（一次分配），完成后值不再变化
+错误传播：失败以 RespCode 表示，then 遇到失败直接跳过用户函数把错误码传给下游
+后续执行：完成时在完成线程（通常是 I/O 线程）上执行后续；挂接时若已完成则立即执行
+组合：then 链式调用（支持返回 Future 的函数自动展开），whenAll 全部完成，whenAny 首个完成
+只有副作用的后续（返回 void）得到 Future<std::monostate>，仍可继续 then 或等待完成
+*/
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <type_traits>
+#include <variant>
+#include "fields.hpp"
+
+namespace lcz_rpc
+{
+    template <typename T>
+    class Future;
+    template <typename T>
+    class Promise;
+
+    // Promise/Future 共享状态
+    template <typename T>
+    struct FutureState
+    {
+        using ptr = std::shared_ptr<FutureState<T>>;
+        using Continuation = std::function<void(RespCode, const T &)>;
+        std::mutex mutex;
+        std::condition_variable cond;
+        bool ready = false;
+        RespCode rcode = RespCode::SUCCESS;
+        T value;
+        Continuation continuation;
+        // 只有第一次完成生效，返回是否由本次完成
+        bool complete(RespCode code, T &&val)
+        {
+            Continuation cont;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (ready) return false;
+                rcode = code;
+                value = std::move(val);
+                ready = true;
+                cont = std::move(continuation);
+            }
+            cond.notify_all();
+            if (cont) cont(rcode, value); // ready 之后 value 不再被修改，无需持锁读取
+            return true;
+        }
+        void onComplete(Continuation cont)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (!ready)
+                {
+                    if (continuation) // 已有后续时串联执行，避免覆盖
+                    {
+                        auto prev = std::move(continuation);
+                        continuation = [prev, cont](RespCode code, const T &val) {
+                            prev(code, val);
+                            cont(code, val);
+                        };
+                    }
+                    else continuation = std::move(cont);
+                    return;
+                }
+            }
+            cont(rcode, value);
+        }
+    };
+
+    template <typename T>
+    struct IsFuture : std::false_type { using inner = T; };
+    template <typename T>
+    struct IsFuture<Future<T>> : std::true_type { using inner = T; };
+    // then 的结果类型：返回 void 的后续以 std::monostate 表示“完成但没有值”
+    template <typename T>
+    using ThenResult = std::conditional_t<std::is_void<T>::value, std::monostate, T>;
+
+    template <typename T>
+    class Future
+    {
+    public:
+        using Continuation = typename FutureState<T>::Continuation;
+        Future() = default;
+        explicit Future(const typename FutureState<T>::ptr &state) : _state(state) {}
+        bool valid() const { return _state.get() != nullptr; }
+        // 是否已完成（不阻塞）
+        bool ready() const
+        {
+            std::unique_lock<std::mutex> lock(_state->mutex);
+            return _state->ready;
+        }
+        // 阻塞直到完成
+        void wait() const
+        {
+            std::unique_lock<std::mutex> lock(_state->mutex);
+            _state->cond.wait(lock, [this] { return _state->ready; });
+        }
+        // 最多等待 timeout，返回是否已完成
+        bool waitFor(std::chrono::milliseconds timeout) const
+        {
+            std::unique_lock<std::mutex> lock(_state->mutex);
+            return _state->cond.wait_for(lock, timeout, [this] { return _state->ready; });
+        }
+        // 阻塞获取结果；失败时返回默认值，需要区分时配合 rcode()/ok()
+        const T &get() const
+        {
+            wait();
+            return _state->value;
+        }
+        // 阻塞获取响应码
+        RespCode rcode() const
+        {
+            wait();
+            return _state->rcode;
+        }
+        bool ok() const { return rcode() == RespCode::SUCCESS; }
+        // 挂接原始后续：成功失败都会触发
+        void onComplete(Continuation cont) const { _state->onComplete(std::move(cont)); }
+        // 成功时以结果调用 f，f 可以返回普通值或 Future；失败直接把错误码传给返回的 Future
+        template <typename F, typename R = ThenResult<std::decay_t<std::invoke_result_t<F &, const T &>>>>
+        Future<typename IsFuture<R>::inner> then(F f) const
+        {
+            using U = typename IsFuture<R>::inner;
+            Promise<U> promise;
+            Future<U> next = promise.future();
+            onComplete([promise, f](RespCode code, const T &val) mutable {
+                if (code != RespCode::SUCCESS)
+                {
+                    promise.setError(code);
+                    return;
+                }
+                if constexpr (IsFuture<R>::value)
+                {
+                    f(val).onComplete([promise](RespCode inner_code, const U &inner_val) {
+                        if (inner_code == RespCode::SUCCESS) promise.setValue(inner_val);
+                        else promise.setError(inner_code);
+                    });
+                }
+                else if constexpr (std::is_void<std::invoke_result_t<F &, const T &>>::value)
+                {
+                    f(val);
+                    promise.setValue(std::monostate());
+                }
+                else
+                {
+                    promise.setValue(f(val));
+                }
+            });
+            return next;
+        }
+
+    private:
+        typename FutureState<T>::ptr _state;
+    };
+
+    template <typename T>
+    class Promise
+    {
+    public:
+        Promise() : _state(std::make_shared<FutureState<T>>()) {}
+        Future<T> future() const { return Future<T>(_state); }
+        // 设置结果/错误，只有第一次调用生效
+        bool setValue(T val) const { return _state->complete(RespCode::SUCCESS, std::move(val)); }
+        bool setError(RespCode rcode) const { return _state->complete(rcode, T()); }
+
+    private:
+        typename FutureState<T>::ptr _state;
+    };
+
+    // 全部成功后得到按顺序排列的结果；任意一个失败则以其错误码失败
+    template <typename T>
+    Future<std::vector<T>> whenAll(const std::vector<Future<T>> &futures)
+    {
+        Promise<std::vector<T>> promise;
+        if (futures.empty())
+        {
+            promise.setValue(std::vector<T>());
+            return promise.future();
+        }
+        struct AllState
+        {
+            std::vector<T> values;
+            std::atomic<size_t> remaining{0};
+        };
+        auto all = std::make_shared<AllState>();
+        all->values.resize(futures.size());
+        all->remaining = futures.size();
+        for (size_t i = 0; i < futures.size(); ++i)
+        {
+            futures[i].onComplete([all, promise, i](RespCode code, const T &val) {
+                if (code != RespCode::SUCCESS)
+                {
+                    promise.setError(code);
+                    return;
+                }
+                all->values[i] = val;
+                if (all->remaining.fetch_sub(1) == 1) promise.setValue(std::move(all->values));
+            });
+        }
+        return promise.future();
+    }
+
+    // 首个完成的 future 决定结果：(下标, 结果)，首个完成者失败则以其错误码失败
+    template <typename T>
+    Future<std::pair<size_t, T>> whenAny(const std::vector<Future<T>> &futures)
+    {
+        Promise<std::pair<size_t, T>> promise;
+        if (futures.empty())
+        {
+            promise.setError(RespCode::INVALID_PARAMS);
+            return promise.future();
+        }
+        for (size_t i = 0; i < futures.size(); ++i)
+        {
+            futures[i].onComplete([promise, i](RespCode code, const T &val) {
+                if (code != RespCode::SUCCESS) promise.setError(code);
+                else promise.setValue(std::make_pair(i, val));
+            });
+        }
+        return promise.future();
+    }
+}
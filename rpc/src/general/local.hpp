@@ -0,0 +1,72 @@
+#pragma once
+/*进程内短路：同一进程里既有 RpcServer 又有 RpcClient 时，发往本进程提供者的调用不经过序列化和回环 TCP
+RpcServer 构造时把自己的路由器按访问地址登记到 LocalRegistry，析构时撤销
+RpcClient 选出的提供者地址在登记表中时，直接在本进程的路由器上执行服务，结果经同一个完成回调返回
+*/
+#include <map>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <functional>
+#include <jsoncpp/json/json.h>
+#include "fields.hpp"
+#include "publicconfig.hpp"
+#include "rcu.hpp"
+
+namespace lcz_rpc
+{
+    // 进程内可直接调用的服务端点（由 RpcRouter 实现）
+    class LocalEndpoint
+    {
+    public:
+        using ptr = std::shared_ptr<LocalEndpoint>;
+        using Reply = std::function<void(RespCode, const Json::Value &)>;
+        virtual ~LocalEndpoint() = default;
+        // 执行 method，完成后调用 reply；与网络请求走相同的查找、参数校验和返回值校验
+        virtual void invoke(const std::string &method, const Json::Value &params, const Reply &reply) = 0;
+    };
+
+    // 访问地址 -> 本进程端点；登记只在服务启停时发生，查找读快照不加锁
+    class LocalRegistry
+    {
+    public:
+        static LocalRegistry &instance()
+        {
+            static LocalRegistry registry;
+            return registry;
+        }
+        void add(const HostInfo &host, const LocalEndpoint::ptr &endpoint)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            auto next = std::make_shared<EndpointMap>(*_endpoints.load());
+            (*next)[host] = endpoint;
+            _endpoints.store(std::move(next));
+        }
+        // 只撤销自己登记的端点，避免同地址的新服务被旧服务的析构撤掉
+        void remove(const HostInfo &host, const LocalEndpoint::ptr &endpoint)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            auto cur = _endpoints.load();
+            auto it = cur->find(host);
+            if (it == cur->end() || it->second.lock() != endpoint) return;
+            auto next = std::make_shared<EndpointMap>(*cur);
+            next->erase(host);
+            _endpoints.store(std::move(next));
+        }
+        // 本进程没有该地址的服务（或服务已析构）时返回空
+        LocalEndpoint::ptr find(const HostInfo &host) const
+        {
+            auto endpoints = _endpoints.load();
+            if (endpoints->empty()) return LocalEndpoint::ptr();// 常见情况：进程内没有服务
+            auto it = endpoints->find(host);
+            return it == endpoints->end() ? LocalEndpoint::ptr() : it->second.lock();
+        }
+
+    private:
+        LocalRegistry() = default;
+        // 只持有弱引用：端点的生命周期由 RpcServer 决定
+        using EndpointMap = std::map<HostInfo, std::weak_ptr<LocalEndpoint>>;
+        std::mutex _mutex;
+        RcuPtr<EndpointMap> _endpoints;
+    };
+}
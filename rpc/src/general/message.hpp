@@ -100,12 +100,34 @@ namespace lcz_rpc
     {
         public:
         using ptr = std::shared_ptr<RpcRequest>;  
+        //帧头带方法 ID 的请求先只保存消息体，服务端准入之后再解码，被拒绝的请求不做 JSON 解析
+        virtual bool unserialize(const std::string &msg)override
+        {
+            if(methodId()==kInvalidMethodId)return JsonMessage::unserialize(msg);
+            _body=msg;
+            return true;
+        }
+        //解码延迟保存的消息体，没有待解码的内容时直接返回 true
+        bool decode()
+        {
+            if(_body.empty())return true;
+            std::string body;
+            body.swap(_body);
+            return JSON::deserialize(body,_data);
+        }
         virtual bool check()override
         {
-            //长度 消息类型 id长度 id data
+            if(decode()==false)
+            {
+                ELOG("Body decode failed!");
+                return false;
+            }
+            //长度 消息类型 id长度 [方法ID] id data
             //     Rpcrequest
-            if(_data[KEY_METHOD].isString()==false/*消息类型不为字符串*/||
-            _data[KEY_METHOD].isNull()/*消息类型不能为空*/)
+            //帧头携带方法 ID 时消息体可以不带方法名
+            if(methodId()==kInvalidMethodId&&
+            (_data[KEY_METHOD].isString()==false/*消息类型不为字符串*/||
+            _data[KEY_METHOD].isNull()/*消息类型不能为空*/))
             {
                ELOG("Method is not string or null!");
                 return false;
@@ -127,6 +149,8 @@ namespace lcz_rpc
         {
                 _data[KEY_PARAMS] = params;
         }
+        private:
+        std::string _body;//尚未解码的消息体
     };
     //Rpc响应消息
     class RpcResponse:public JsonResponse
@@ -321,6 +345,24 @@ namespace lcz_rpc
     //     HostInfoDetail(const std::string &ip_, int port_, int load_)
     //         : ip(ip_), port(port_), load(load_) {}
     // };
+    //位置标签与 Json 对象互转，服务请求和服务响应共用
+    inline Locality parseLocality(const Json::Value &value)
+    {
+        Locality locality;
+        if(!value.isObject())return locality;
+        locality.zone = value.get(KEY_ZONE,"").asString();
+        locality.rack = value.get(KEY_RACK,"").asString();
+        locality.node = value.get(KEY_NODE,"").asString();
+        return locality;
+    }
+    inline Json::Value localityToJson(const Locality &locality)
+    {
+        Json::Value value(Json::objectValue);
+        if(!locality.zone.empty())value[KEY_ZONE] = locality.zone;
+        if(!locality.rack.empty())value[KEY_RACK] = locality.rack;
+        if(!locality.node.empty())value[KEY_NODE] = locality.node;
+        return value;
+    }
     //服务请求消息
     class ServiceRequest:public JsonRequest
     {
@@ -333,6 +375,39 @@ namespace lcz_rpc
         {
             _data[KEY_LOAD] = load;
         }
+        int weight()const{
+            return _data.get(KEY_WEIGHT,1).asInt();//未携带权重的旧版本提供者按 1 处理
+        }
+        void setWeight(int weight)
+        {
+            _data[KEY_WEIGHT] = weight;
+        }
+        Locality locality()const
+        {
+            return parseLocality(_data[KEY_LOCALITY]);
+        }
+        void setLocality(const Locality &locality)
+        {
+            if(!locality.empty())_data[KEY_LOCALITY] = localityToJson(locality);
+        }
+        //批量服务发现的方法列表
+        std::vector<std::string> methods()const
+        {
+            std::vector<std::string> methods;
+            for(const auto &method : _data[KEY_METHODS])
+            {
+                methods.push_back(method.asString());
+            }
+            return methods;
+        }
+        void setMethods(const std::vector<std::string> &methods)
+        {
+            _data[KEY_METHODS] = Json::Value(Json::arrayValue);
+            for(const auto &method : methods)
+            {
+                _data[KEY_METHODS].append(method);
+            }
+        }
         virtual bool check()override
         {
            
@@ -349,6 +424,15 @@ namespace lcz_rpc
                ELOG("Op type is not integral or null!");
                 return false;
             }
+            if(_data[KEY_OPTYPE].asInt()==static_cast<int>(ServiceOpType::DISCOVER_BATCH))
+            {
+                if(_data[KEY_METHODS].isArray()==false)
+                {
+                    ELOG("批量服务发现没有携带方法列表!");
+                    return false;
+                }
+                return true;
+            }
             //不是服务发现的话，就需要提供主机信息
             if(_data[KEY_OPTYPE].asInt()!=static_cast<int>(ServiceOpType::DISCOVER)&&
                 (_data[KEY_HOST].isObject()==false||
@@ -474,27 +558,58 @@ namespace lcz_rpc
          }
          //添加负载上报后的获取负载均衡后的主机详情方法
         std::vector<HostDetail> hostsDetail() const
+        {
+            return parseHostDetails(_data[KEY_HOST]);
+        }
+        void setHostDetails(const std::vector<HostDetail> &addresses) {
+            _data[KEY_HOST] = toJson(addresses);
+        }
+        //批量服务发现结果：方法名 -> 主机详情，没有提供者的方法不出现
+        std::unordered_map<std::string, std::vector<HostDetail>> methodHostsDetail() const
+        {
+            std::unordered_map<std::string, std::vector<HostDetail>> ret;
+            for(const auto &method : _data[KEY_METHODS].getMemberNames())
+            {
+                ret[method] = parseHostDetails(_data[KEY_METHODS][method]);
+            }
+            return ret;
+        }
+        void setMethodHostsDetail(const std::unordered_map<std::string, std::vector<HostDetail>> &details)
+        {
+            _data[KEY_METHODS] = Json::Value(Json::objectValue);
+            for(const auto &item : details)
+            {
+                _data[KEY_METHODS][item.first] = toJson(item.second);
+            }
+        }
+        private:
+        static std::vector<HostDetail> parseHostDetails(const Json::Value &hosts)
         {
             std::vector<HostDetail> hostsdetails;
-            
-            for(int i = 0; i < _data[KEY_HOST].size(); i++)
+            for(int i = 0; i < hosts.size(); i++)
             {
-                HostInfo host(_data[KEY_HOST][i][KEY_HOST_IP].asString(),
-                             _data[KEY_HOST][i][KEY_HOST_PORT].asInt());
-                int load = _data[KEY_HOST][i].get(KEY_LOAD,0).asInt();
-                hostsdetails.emplace_back(host, load);
+                HostInfo host(hosts[i][KEY_HOST_IP].asString(),
+                             hosts[i][KEY_HOST_PORT].asInt());
+                int load = hosts[i].get(KEY_LOAD,0).asInt();
+                int weight = hosts[i].get(KEY_WEIGHT,1).asInt();
+                hostsdetails.emplace_back(host, load, weight);
+                hostsdetails.back().locality = parseLocality(hosts[i][KEY_LOCALITY]);
             }
             return hostsdetails;
         }
-        void setHostDetails(const std::vector<HostDetail> &addresses) {
-            _data[KEY_HOST] = Json::Value(Json::arrayValue);
+        static Json::Value toJson(const std::vector<HostDetail> &addresses)
+        {
+            Json::Value hosts(Json::arrayValue);
             for (const auto &detail : addresses) {
                 Json::Value hostObj(Json::objectValue);
                 hostObj[KEY_HOST_IP] = detail.host.first;
                 hostObj[KEY_HOST_PORT] = detail.host.second;
                 hostObj[KEY_LOAD] = detail.load;
-                _data[KEY_HOST].append(hostObj);
+                hostObj[KEY_WEIGHT] = detail.weight;
+                if(!detail.locality.empty())hostObj[KEY_LOCALITY] = localityToJson(detail.locality);
+                hosts.append(hostObj);
             }
+            return hosts;
         }
 
        
@@ -70,7 +70,7 @@ namespace lcz_rpc
          return std::make_shared<MuduoBuffer>(std::forward<ARGS>(args)...);
       }
     };
-    // 基于 「长度 + 类型 + id + body」 的简单协议
+    // 基于 「长度 + 类型 + id + body」 的简单协议，RPC 请求可在 id 长度之后携带方法 ID
     class LVProtocol :public BaseProtocol
     {
       public:
@@ -96,14 +96,23 @@ namespace lcz_rpc
           {
             if(!canProcessed(buf)){return false;}
             int32_t total_len=buf->readInt32();
-            MsgType msgtype=static_cast<MsgType>(buf->readInt32());
+            int32_t type_field=buf->readInt32();
+            MsgType msgtype=static_cast<MsgType>(type_field&kMsgTypeMask);
             int32_t id_len=buf->readInt32();
             int32_t data_len=total_len-_msgidfield_len-_msgtypefield_len-id_len;
+            MethodId method_id=kInvalidMethodId;
+            if(type_field&kMethodIdFlag)//帧头携带方法 ID
+            {
+               method_id=static_cast<MethodId>(buf->readInt32());
+               data_len-=_methodidfield_len;
+            }
+            if(id_len<0||data_len<0){ELOG("帧长度字段非法");return false;}
             
             std::string id=buf->retrieveAsString(id_len);     
             std::string data=buf->retrieveAsString(data_len);
             msg=MessageFactory::create(msgtype);
             if(msg.get()==nullptr){ELOG("创建消息失败");return false;}
+            if(method_id!=kInvalidMethodId)msg->setMethodId(method_id);//先于反序列化设置，消息据此决定是否延迟解码
             bool ret=msg->unserialize(data);//反序列化数据
             if(!ret){ELOG("反序列化数据失败");return false;}
             msg->setId(id);
@@ -123,8 +132,12 @@ namespace lcz_rpc
             int32_t id_len = static_cast<int32_t>(id.size());        
             int32_t data_len = static_cast<int32_t>(data.size());
 
+            MethodId method_id = msg->methodId();
+            bool has_method_id = method_id != kInvalidMethodId;
+            if(has_method_id) msgtype |= kMethodIdFlag;
+
             //计算总长度
-            int32_t total_len=_msgtypefield_len+_msgidfield_len+id_len+data_len;
+            int32_t total_len=_msgtypefield_len+_msgidfield_len+id_len+data_len+(has_method_id?_methodidfield_len:0);
 
             //转换为网络字节序，保证跨平台移植性
             auto total_len_net = htonl(total_len);
@@ -132,10 +145,15 @@ namespace lcz_rpc
             auto id_len_net = htonl(id_len);
 
             std::string output;
-            output.reserve(total_len);
+            output.reserve(_totalfield_len+total_len);
             output.append((char*)&total_len_net,_totalfield_len);
             output.append((char*)&msgtype_net,_msgtypefield_len);
             output.append((char*)&id_len_net,_msgidfield_len);
+            if(has_method_id)
+            {
+              auto method_id_net = htonl(method_id);
+              output.append((char*)&method_id_net,_methodidfield_len);
+            }
             output.append(id);
             output.append(data);
             return output;
@@ -144,6 +162,11 @@ namespace lcz_rpc
           const size_t _totalfield_len=4;      
           const size_t _msgtypefield_len=4;
           const size_t _msgidfield_len=4;
+          const size_t _methodidfield_len=4;
+          //类型字段的低 16 位为消息类型；置位 kMethodIdFlag 时 id 长度之后多一个 4 字节的方法 ID
+          //只有握手拿到方法 ID 表的客户端才会发送带该标志的帧，旧版本的对端不会收到
+          static constexpr int32_t kMsgTypeMask=0xFFFF;
+          static constexpr int32_t kMethodIdFlag=0x10000;
       };
       class ProtocolFactory
       {
@@ -171,6 +194,17 @@ namespace lcz_rpc
             std::string data=_protocol->serialize(msg);
              _connection->send(data);
           }
+          // 批量发送：所有消息序列化到同一块缓冲区，只触发一次 TcpConnection::send
+          virtual void send(const std::vector<BaseMessage::ptr> &msgs)override
+          {
+            std::string data;
+            for(auto &msg:msgs)
+            {
+               data.append(_protocol->serialize(msg));
+            }
+            if(data.empty())return;
+            _connection->send(data);
+          }
           // 关闭连接
           virtual void shutdown()override
           {
@@ -317,7 +351,9 @@ namespace lcz_rpc
                  _downlatch.countDown();
               }
               else{
-                DLOG("连接断开");_connection.reset();
+                DLOG("连接断开");
+                if(_connection && _cb_close)_cb_close(_connection);//通知上层让等待中的请求失败
+                _connection.reset();
               } 
            }
            void onMessage(const muduo::net::TcpConnectionPtr& conn,muduo::net::Buffer* buf,muduo::Timestamp receiveTime)
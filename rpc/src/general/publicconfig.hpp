@@ -1,18 +1,50 @@
 #pragma once
 #include <chrono>
+#include <string>
+#include <cstdint>
+#include <unordered_map>
 namespace lcz_rpc
 {
     typedef std::pair<std::string,int32_t> HostInfo;//主机信息
+    typedef uint32_t MethodId;//服务端为方法分配的整数 ID，方法在进程内保持不变
+    constexpr MethodId kInvalidMethodId = 0xFFFFFFFFu;
+    typedef std::unordered_map<std::string,MethodId> MethodIdTable;//方法名 -> 方法 ID，客户端与服务端握手时取得
 
     struct HeartbeatConfig {
         double check_interval_sec = 5.0;    // 检查频率：每5秒扫描一次
         int idle_timeout_sec = 15;          // 空闲超时：15秒没收到心跳则视为离线
         int heartbeat_interval_sec = 10;    // 心跳间隔：提供者每10秒发一次心跳
     };
+    // 客户端被动健康检查：按调用结果统计每台提供者，异常时临时摘除
+    struct HealthPolicy {
+        bool enable = true;
+        int consecutive_failures = 5;       // 连续失败达到该次数立即摘除
+        double error_rate = 0.5;            // 错误率（EWMA）超过该值摘除
+        int min_requests = 20;              // 错误率判定前至少需要的样本数
+        int latency_threshold_ms = 0;       // 延迟（EWMA）超过该值摘除，<=0 不按延迟摘除
+        int base_eject_ms = 1000;           // 首次摘除时长，连续被摘除时翻倍
+        int max_eject_ms = 30000;           // 摘除时长上限
+        double max_eject_percent = 0.5;     // 同时被摘除的主机比例上限，避免摘光
+    };
+    // 位置标签：由远及近为 可用区/机架/物理机，未设置的层级视为未知
+    struct Locality {
+        std::string zone;
+        std::string rack;
+        std::string node;
+        bool empty() const { return zone.empty() && rack.empty() && node.empty(); }
+    };
+    // 就近路由：优先选择离客户端最近的一层（同机 > 同机架 > 同可用区 > 其他），该层可用容量不足时溢出到下一层
+    struct LocalityPolicy {
+        int min_hosts = 1;                  // 一层至少有这么多台可用主机才使用该层
+        double min_healthy_ratio = 0.7;     // 一层中可用主机占比低于该值时溢出到下一层
+        int max_load = 80;                  // 一层可用主机的平均上报负载（0~100）超过该值时溢出到下一层
+    };
     struct HostDetail {
         HostInfo host;
         int load = 0;
-        HostDetail(const HostInfo &host,int load) : host(host),load(load) {}
-        HostDetail() : host(HostInfo()),load(0) {}
+        int weight = 1;//注册时声明的静态容量，WEIGHTED_ROUND_ROBIN 使用
+        Locality locality;//提供者注册的位置标签
+        HostDetail(const HostInfo &host,int load,int weight = 1) : host(host),load(load),weight(weight) {}
+        HostDetail() : host(HostInfo()),load(0),weight(1) {}
     };
 }
\ No newline at end of file
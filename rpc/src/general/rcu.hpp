@@ -0,0 +1,130 @@
+#pragma once
+/*RCU 风格的共享指针：读多写少的数据以不可变快照发布
+读：load() 拿到当前快照的引用计数，之后在快照上只读访问；读路径无锁
+写：调用方自行串行化（通常持有一把写锁），复制当前快照、修改后 store() 替换
+旧快照在最后一个读者释放后自动销毁
+
+实现：当前快照挂在一个节点上，节点指针是普通的原子指针；读者用冒险指针（hazard pointer）声明正在读的节点，
+再从节点拷贝 shared_ptr（一次原子加引用计数），写者只回收没有被任何读者声明的旧节点，仍被声明的留到下一次 store 再试
+std::atomic_load(shared_ptr*) 和 std::atomic<shared_ptr> 在 libstdc++ 上都不是无锁的，前者还共用一个进程级的哈希锁池，所以不用
+*/
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+namespace lcz_rpc
+{
+    namespace rcu
+    {
+        // 每个线程一条冒险指针记录：load 不会重入，一个线程同一时刻最多声明一个节点
+        // 记录只追加不释放，线程退出后标记为空闲，供新线程复用
+        struct HazardRecord
+        {
+            std::atomic<const void *> hazard{nullptr};
+            std::atomic<bool> active{false};
+            HazardRecord *next = nullptr;
+        };
+        inline std::atomic<HazardRecord *> &hazardList()
+        {
+            static std::atomic<HazardRecord *> head{nullptr};
+            return head;
+        }
+        inline HazardRecord *acquireRecord()
+        {
+            std::atomic<HazardRecord *> &head = hazardList();
+            for (HazardRecord *rec = head.load(std::memory_order_acquire); rec; rec = rec->next)
+            {
+                bool idle = false;
+                if (rec->active.compare_exchange_strong(idle, true)) return rec;
+            }
+            HazardRecord *rec = new HazardRecord();
+            rec->active.store(true, std::memory_order_relaxed);
+            rec->next = head.load(std::memory_order_relaxed);
+            while (!head.compare_exchange_weak(rec->next, rec, std::memory_order_release, std::memory_order_relaxed)) {}
+            return rec;
+        }
+        inline HazardRecord &localRecord()
+        {
+            struct Holder
+            {
+                HazardRecord *rec = acquireRecord();
+                ~Holder()
+                {
+                    rec->hazard.store(nullptr, std::memory_order_release);
+                    rec->active.store(false, std::memory_order_release);
+                }
+            };
+            thread_local Holder holder;
+            return *holder.rec;
+        }
+        // 当前所有线程声明的节点
+        inline void collectHazards(std::vector<const void *> &out)
+        {
+            for (HazardRecord *rec = hazardList().load(std::memory_order_acquire); rec; rec = rec->next)
+            {
+                const void *p = rec->hazard.load(std::memory_order_seq_cst);
+                if (p) out.push_back(p);
+            }
+        }
+    }
+
+    template <typename T>
+    class RcuPtr
+    {
+    public:
+        using ptr = std::shared_ptr<const T>;
+        RcuPtr() : RcuPtr(std::make_shared<const T>()) {}
+        explicit RcuPtr(ptr value) : _node(new Node{std::move(value)}) {}
+        RcuPtr(const RcuPtr &) = delete;
+        RcuPtr &operator=(const RcuPtr &) = delete;
+        // 析构时不应再有读者
+        ~RcuPtr()
+        {
+            delete _node.load(std::memory_order_relaxed);
+            for (Node *node : _retired) delete node;
+        }
+        ptr load() const
+        {
+            rcu::HazardRecord &rec = rcu::localRecord();
+            Node *node = _node.load(std::memory_order_acquire);
+            while (true)
+            {
+                rec.hazard.store(node, std::memory_order_seq_cst);
+                Node *again = _node.load(std::memory_order_seq_cst);// 声明之后节点仍是当前节点，写者就一定能看到这次声明
+                if (again == node) break;
+                node = again;
+            }
+            ptr value = node->value;
+            rec.hazard.store(nullptr, std::memory_order_release);
+            return value;
+        }
+        void store(ptr value)
+        {
+            Node *fresh = new Node{std::move(value)};
+            std::vector<Node *> reclaim;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _retired.push_back(_node.exchange(fresh, std::memory_order_seq_cst));
+                std::vector<const void *> hazards;
+                rcu::collectHazards(hazards);
+                auto keep = std::partition(_retired.begin(), _retired.end(), [&hazards](Node *node) {
+                    return std::find(hazards.begin(), hazards.end(), node) != hazards.end();
+                });
+                reclaim.assign(keep, _retired.end());
+                _retired.erase(keep, _retired.end());
+            }
+            for (Node *node : reclaim) delete node;// 在锁外释放：旧快照可能很大
+        }
+
+    private:
+        struct Node
+        {
+            ptr value;
+        };
+        std::atomic<Node *> _node;
+        std::mutex _mutex;// 保护 _retired，只在写入时使用
+        std::vector<Node *> _retired;// 已替换、回收时仍被读者声明的节点
+    };
+}
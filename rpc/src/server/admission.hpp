@@ -0,0 +1,208 @@
+#pragma once
+/*服务端准入控制：过载时拒绝少量请求，而不是让所有请求一起变慢
+两条规则，任一触发即以 OVERLOADED 拒绝：
+1. 在途请求数（已接收、尚未应答，含排队中和异步挂起的）达到上限
+2. CoDel：工作线程取出任务时报告排队时间（sojourn），一个观察窗口内排队时间始终高于目标，说明形成了消不掉的常驻队列，
+   进入拒绝状态：立即拒绝一个新请求，之后每隔 interval/sqrt(count) 再拒绝一个（count 为本轮已拒绝数），拒绝逐渐加密直到排队时间回落；
+   出现一次低于目标的排队时间或队列排空即退出拒绝状态。短时间内再次进入时沿用上一轮的拒绝频率（RFC 8289）
+   排队时间只在请求投递到工作线程池（ExecMode::POOLED）时测量，没有工作线程池时只有第 1 条规则生效；
+   CoDel 安排的拒绝也只落在将要排队的请求上，INLINE 执行的请求不替池化的方法承担拒绝
+拒绝发生在解码参数之前，被拒绝的请求几乎不消耗服务端资源；客户端重试和负载均衡把 OVERLOADED 视为该主机暂时不可用
+*/
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <cmath>
+#include <cstdint>
+#include "../general/detail.hpp"
+
+namespace lcz_rpc
+{
+    namespace server
+    {
+        // 准入配置，可全局设置，也可按方法设置（两者同时生效）
+        // target_ms/interval_ms 只约束投递到工作线程池（ExecMode::POOLED）的请求：INLINE 执行或未设置工作线程池时没有排队时间，只有 max_inflight 生效
+        struct AdmissionPolicy
+        {
+            int max_inflight = 0;        // 在途请求上限，<=0 不限制
+            int target_ms = 5;           // 排队时间目标
+            int interval_ms = 100;       // 观察窗口：排队时间持续高于目标这么久才开始拒绝，也是拒绝间隔的基数；<=0 不按排队时间拒绝
+        };
+
+        class AdmissionController
+        {
+        public:
+            using ptr = std::shared_ptr<AdmissionController>;
+            struct Stats
+            {
+                int inflight = 0;        // 在途请求数
+                int queued = 0;          // 已准入、尚在工作线程池排队的请求数
+                uint64_t admitted = 0;   // 准入的请求数
+                uint64_t rejected = 0;   // 拒绝的请求数
+                bool dropping = false;   // 是否处于 CoDel 拒绝状态
+                uint32_t drop_count = 0; // 本轮 CoDel 已安排的拒绝数，决定拒绝间隔
+            };
+            AdmissionController(const AdmissionPolicy &policy)
+                : _max_inflight(policy.max_inflight),
+                  _target_us(static_cast<int64_t>(policy.target_ms) * 1000),
+                  _interval_us(static_cast<int64_t>(policy.interval_ms) * 1000) {}
+            // 请求到达：准入时占用一个在途名额，与 release 成对调用
+            // pooled 表示请求将投递到工作线程池；只有这样的请求会消耗 CoDel 安排的拒绝，就地执行的请求不会加重排队
+            bool tryAcquire(bool pooled = true)
+            {
+                // 消耗一个 CoDel 安排的拒绝
+                int pending = pooled ? _pending_drops.load(std::memory_order_relaxed) : 0;
+                while (pending > 0)
+                {
+                    if (_pending_drops.compare_exchange_weak(pending, pending - 1, std::memory_order_relaxed)) return reject();
+                }
+                int inflight = _inflight.fetch_add(1, std::memory_order_relaxed);
+                if (_max_inflight > 0 && inflight >= _max_inflight)
+                {
+                    _inflight.fetch_sub(1, std::memory_order_relaxed);
+                    return reject();
+                }
+                _admitted.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            // 请求已应答或被丢弃
+            void release() { _inflight.fetch_sub(1, std::memory_order_relaxed); }
+            // 准入的请求投递到工作线程池
+            void onEnqueue() { _queued.fetch_add(1, std::memory_order_relaxed); }
+            // 工作线程取出请求：按排队时间推进 CoDel 状态，到了拒绝时间就安排拒绝下一个到达的请求
+            // 请求已经解码并排过队，拒绝它本身不再省资源，所以拒绝落在新到达的请求上；每次出队最多安排一个拒绝
+            void onDequeue(int64_t sojourn_us, int64_t now_us)
+            {
+                bool drained = _queued.fetch_sub(1, std::memory_order_relaxed) == 1;
+                if (_interval_us <= 0) return;
+                std::unique_lock<std::mutex> lock(_codel_mutex);
+                bool ok_to_drop = false;
+                if (sojourn_us < _target_us || drained) _first_above_us = 0;// 队列已排空说明没有常驻队列，与 RFC 8289 一样重新观察
+                else if (_first_above_us == 0) _first_above_us = now_us + _interval_us;
+                else if (now_us >= _first_above_us) ok_to_drop = true;
+                if (_dropping.load(std::memory_order_relaxed))
+                {
+                    if (!ok_to_drop)
+                    {
+                        _dropping.store(false, std::memory_order_relaxed);
+                        _pending_drops.store(0, std::memory_order_relaxed);
+                        if (drained)
+                        {
+                            ILOG("[准入控制] 排队已清空，停止拒绝");
+                        }
+                        else
+                        {
+                            ILOG("[准入控制] 排队时间回落到 %ldms 以下，停止拒绝", static_cast<long>(_target_us / 1000));
+                        }
+                    }
+                    else if (now_us >= _drop_next_us)
+                    {
+                        _pending_drops.fetch_add(1, std::memory_order_relaxed);
+                        ++_drop_count;
+                        _drop_next_us = controlLaw(_drop_next_us);
+                    }
+                }
+                else if (ok_to_drop)
+                {
+                    _dropping.store(true, std::memory_order_relaxed);
+                    _pending_drops.fetch_add(1, std::memory_order_relaxed);
+                    // 刚退出不久（16 个窗口内）又进入拒绝状态，说明上一轮的拒绝频率还不够，从上一轮的 count 继续
+                    uint32_t delta = _drop_count - _last_count;
+                    _drop_count = (delta > 1 && now_us - _drop_next_us < 16 * _interval_us) ? delta : 1;
+                    _drop_next_us = controlLaw(now_us);
+                    _last_count = _drop_count;
+                    WLOG("[准入控制] 排队时间持续超过 %ldms，开始拒绝新请求", static_cast<long>(_target_us / 1000));
+                }
+            }
+            Stats stats() const
+            {
+                Stats st;
+                st.inflight = _inflight.load(std::memory_order_relaxed);
+                st.queued = _queued.load(std::memory_order_relaxed);
+                st.admitted = _admitted.load(std::memory_order_relaxed);
+                st.rejected = _rejected.load(std::memory_order_relaxed);
+                st.dropping = _dropping.load(std::memory_order_relaxed);
+                std::unique_lock<std::mutex> lock(_codel_mutex);
+                st.drop_count = _drop_count;
+                return st;
+            }
+
+        private:
+            bool reject()
+            {
+                _rejected.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            // 下一次拒绝的时间：拒绝越多间隔越短
+            int64_t controlLaw(int64_t t) const
+            {
+                return t + static_cast<int64_t>(_interval_us / std::sqrt(static_cast<double>(_drop_count)));
+            }
+            const int _max_inflight;
+            const int64_t _target_us;
+            const int64_t _interval_us;
+            std::atomic<int> _inflight{0};
+            std::atomic<int> _queued{0};
+            std::atomic<bool> _dropping{false};
+            std::atomic<int> _pending_drops{0};// 已安排、尚未落到新请求上的拒绝数
+            // CoDel 状态，由 _codel_mutex 保护，只在工作线程出队时更新
+            mutable std::mutex _codel_mutex;
+            int64_t _first_above_us = 0;// 排队时间首次高于目标后，窗口结束的时间；0 表示当前低于目标
+            int64_t _drop_next_us = 0;   // 拒绝状态下，下一次拒绝的时间
+            uint32_t _drop_count = 0;    // 本轮已安排的拒绝数
+            uint32_t _last_count = 0;    // 上一轮进入拒绝状态时的 count
+            std::atomic<uint64_t> _admitted{0};
+            std::atomic<uint64_t> _rejected{0};
+        };
+
+        // 一个已准入请求占用的名额（全局 + 方法）：应答时归还，请求未应答就被释放时由析构归还
+        class AdmissionTicket
+        {
+        public:
+            using ptr = std::shared_ptr<AdmissionTicket>;
+            // 依次申请全局和方法的名额，任一拒绝时返回空；pooled 表示请求将投递到工作线程池
+            static ptr acquire(const AdmissionController::ptr &global, const AdmissionController::ptr &method, bool pooled)
+            {
+                if (global && !global->tryAcquire(pooled)) return ptr();
+                if (method && !method->tryAcquire(pooled))
+                {
+                    if (global) global->release();
+                    return ptr();
+                }
+                return std::make_shared<AdmissionTicket>(global, method);
+            }
+            AdmissionTicket(const AdmissionController::ptr &global, const AdmissionController::ptr &method)
+                : _global(global), _method(method) {}
+            ~AdmissionTicket() { release(); }
+            void enqueue()
+            {
+                _enqueue_us = nowUs();
+                if (_global) _global->onEnqueue();
+                if (_method) _method->onEnqueue();
+            }
+            void dequeue()
+            {
+                int64_t now = nowUs();
+                if (_global) _global->onDequeue(now - _enqueue_us, now);
+                if (_method) _method->onDequeue(now - _enqueue_us, now);
+            }
+            void release()
+            {
+                if (_released.exchange(true)) return;
+                if (_global) _global->release();
+                if (_method) _method->release();
+            }
+
+        private:
+            static int64_t nowUs()
+            {
+                return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+            }
+            AdmissionController::ptr _global;
+            AdmissionController::ptr _method;
+            int64_t _enqueue_us = 0;
+            std::atomic<bool> _released{false};
+        };
+    }
+}
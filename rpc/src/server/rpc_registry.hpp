@@ -3,6 +3,7 @@
 #include "../general/message.hpp"
 #include "../general/dispacher.hpp"
 #include <set>
+#include <algorithm>
 #include "../general/publicconfig.hpp"
 
 namespace lcz_rpc
@@ -18,12 +19,14 @@ namespace lcz_rpc
                 using ptr=std::shared_ptr<Provider>;
                 std::mutex mutex;
                 int load;
+                int weight;//注册时声明的静态容量
+                Locality locality;//注册时声明的位置标签
                 std::vector<std::string> methods;
                 BaseConnection::ptr conn;
                 HostInfo address;
                 std::chrono::steady_clock::time_point lastheartbeat;//最后心跳时间
                 Provider(const BaseConnection::ptr& connection,const HostInfo& host)
-                    :conn(connection),address(host),load(0),
+                    :conn(connection),address(host),load(0),weight(1),
                      lastheartbeat(std::chrono::steady_clock::now()){}
                 void appendmethod(const std::string& method)
                 {
@@ -31,7 +34,7 @@ namespace lcz_rpc
                     methods.emplace_back(method);
                 }
             };
-            void addProvider(const BaseConnection::ptr& conn,const HostInfo& host,const std::string& method,int load)
+            void addProvider(const BaseConnection::ptr& conn,const HostInfo& host,const std::string& method,int load,int weight,const Locality& locality)
             {
                 Provider::ptr provider;
                 {
@@ -46,6 +49,8 @@ namespace lcz_rpc
                     }
                     _methodwithproviders[method].insert(provider);
                     provider->load=load;
+                    provider->weight=weight;
+                    provider->locality=locality;
                     provider->lastheartbeat=std::chrono::steady_clock::now();
                 }
                     provider->appendmethod(method);
@@ -95,6 +100,8 @@ namespace lcz_rpc
                     detail.host.first = provider->address.first;
                     detail.host.second = provider->address.second;
                     detail.load = provider->load;
+                    detail.weight = provider->weight;
+                    detail.locality = provider->locality;
                     ret.emplace_back(detail);
                 }
                 return ret;
@@ -175,9 +182,11 @@ namespace lcz_rpc
                 std::vector<std::string> methods;//发现过的服务名称
                 BaseConnection::ptr conn;
                 Discoverer(const BaseConnection::ptr& connection):conn(connection){}
+                //客户端会周期性地重新发现同一批方法，已记录的不再追加
                 void appendmethod(const std::string& method)
                 {
                     std::unique_lock<std::mutex> lock(mutex);
+                    if(std::find(methods.begin(),methods.end(),method)!=methods.end())return;
                     methods.emplace_back(method);
                 }
             };
@@ -225,28 +234,32 @@ namespace lcz_rpc
                 _connwithd.erase(it);               
             }
             //当有新的服务提供者上线，进⾏上线通知
-            void onlineNotify(const std::string& method,const HostInfo& host)
+            //上线通知带上负载、容量权重和位置标签，发现者无需再做一次服务发现就能按权重/就近分配
+            void onlineNotify(const std::string& method,const HostDetail& detail)
             {
-                return notify(method,host,ServiceOpType::ONLINE);
+                return notify(method,detail,ServiceOpType::ONLINE);
             }
             //当服务提供者下线，进⾏下线通知
             void offlineNotify(const std::string& method,const HostInfo& host)
             {
-                return notify(method,host,ServiceOpType::OFFLINE);
+                return notify(method,HostDetail(host,0),ServiceOpType::OFFLINE);
             }
             private:
             // 将服务上线/下线事件广播给所有正在等待该 method 的发现者
-            void notify(const std::string& method,const HostInfo& host,ServiceOpType service_type)
+            void notify(const std::string& method,const HostDetail& detail,ServiceOpType service_type)
             {
                 std::unique_lock<std::mutex>lock(_mutex);
                 auto it=_methodwithdiscoverer.find(method);
                 if(it==_methodwithdiscoverer.end()){return ;}
                 auto rpc_msg=MessageFactory::create<ServiceRequest>();
-                rpc_msg->setHost(host);
+                rpc_msg->setHost(detail.host);
                 rpc_msg->setId(uuid());
                 rpc_msg->setMethod(method);
                 rpc_msg->setMsgType(MsgType::REQ_SERVICE);
                 rpc_msg->setOptype(service_type);
+                rpc_msg->setLoad(detail.load);
+                rpc_msg->setWeight(detail.weight);
+                rpc_msg->setLocality(detail.locality);
                 
                 for(auto& provider:it->second)
                 {
@@ -270,8 +283,10 @@ namespace lcz_rpc
                 if(optype==ServiceOpType::REGISTER)
                 {//服务注册通知
                     ILOG("%s:%d 注册服务 %s", msg->host().first.c_str(),msg->host().second, msg->method().c_str());
-                    _provider->addProvider(conn,msg->host(),msg->method(),msg->load());//注册服务
-                    _discoverer->onlineNotify(msg->method(),msg->host());
+                    HostDetail detail(msg->host(),msg->load(),msg->weight());
+                    detail.locality=msg->locality();
+                    _provider->addProvider(conn,detail.host,msg->method(),detail.load,detail.weight,detail.locality);//注册服务
+                    _discoverer->onlineNotify(msg->method(),detail);
                     //后续在这里处理负载均衡
                     return registryResponse(conn,msg);
                 }
@@ -281,6 +296,16 @@ namespace lcz_rpc
                     _discoverer->addDiscoverer(conn,msg->host(),msg->method());
                     return discoverResponse(conn,msg);
                 }
+                else if(optype==ServiceOpType::DISCOVER_BATCH)
+                {//批量服务发现：一次请求登记并返回多个方法的提供者
+                    auto methods=msg->methods();
+                    ILOG("客户端批量发现 %zu 个服务", methods.size());
+                    for(const auto& method:methods)
+                    {
+                        _discoverer->addDiscoverer(conn,msg->host(),method);
+                    }
+                    return discoverBatchResponse(conn,msg,methods);
+                }
                 else if(optype==ServiceOpType::LOAD_REPORT)
                 {//服务负载上报
                     ILOG("%s:%d 上报负载 %d", msg->host().first.c_str(),msg->host().second, msg->load());
@@ -367,6 +392,23 @@ namespace lcz_rpc
                 msg_resp->setHostDetails(hosts);
                 conn->send(msg_resp);
             }
+            //批量服务发现响应：只返回有提供者的方法
+            void discoverBatchResponse(const BaseConnection::ptr& conn,const ServiceRequest::ptr& msg,const std::vector<std::string>& methods)
+            {
+                std::unordered_map<std::string,std::vector<HostDetail>> details;
+                for(const auto& method:methods)
+                {
+                    auto hosts=_provider->methodHostDetails(method);
+                    if(!hosts.empty())details[method]=std::move(hosts);
+                }
+                auto msg_resp=MessageFactory::create<ServiceResponse>();
+                msg_resp->setId(msg->rid());
+                msg_resp->setRcode(RespCode::SUCCESS);
+                msg_resp->setMsgType(MsgType::RSP_SERVICE);
+                msg_resp->setOptype(ServiceOpType::DISCOVER_BATCH);
+                msg_resp->setMethodHostsDetail(details);
+                conn->send(msg_resp);
+            }
             //负载上报响应
             void updateloadResponse(const BaseConnection::ptr& conn,const ServiceRequest::ptr& msg,bool update_success)
             {
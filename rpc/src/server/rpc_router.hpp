@@ -3,9 +3,12 @@
 #include "../general/message.hpp"
 #include "../general/dispacher.hpp"
 #include "../general/publicconfig.hpp"
+#include "../general/local.hpp"
+#include "../general/executor.hpp"
+#include "admission.hpp"
 
 /*服务端对rpc请求的处理
-1. 接收RPC请求 → 2. 根据method名查找服务 → 3. 参数校验
+1. 接收RPC请求 → 2. 根据方法 ID（握手后）或method名查找服务 → 准入控制 → 3. 参数校验
    ↓
 4. 调用服务方法 → 5. 处理业务逻辑 → 6. 返回响应结果
 */
@@ -21,6 +24,13 @@ namespace lcz_rpc{
             NULL_TYPE       // 6: 空值
             
         };
+        // 服务的执行位置
+        enum class ExecMode {
+            DEFAULT = 0,    // 跟随 RpcServer 的默认设置
+            INLINE,         // 在 I/O 线程上直接执行，适合 add 这类耗时极短的方法
+            POOLED          // 投递到工作线程池执行，适合计算密集或会阻塞的方法
+        };
+        class Responder;
         //服务描述类
         // 描述单个 RPC 方法：校验参数、执行回调、校验返回值
         class ServiceDescribe
@@ -29,8 +39,14 @@ namespace lcz_rpc{
             using ptr=std::shared_ptr<ServiceDescribe>;
             using ParamsDescribe=std::pair<std::string,ValType>;
             using ServiceCallback=std::function<void(const Json::Value& ,Json::Value& )>;
-            ServiceDescribe(std::string&& method_name,ServiceCallback&& cb, std::vector<ParamsDescribe>&& params_desc,ValType return_type)
-            :_method_name(std::move(method_name)),_service_cb(std::move(cb)),_params_desc(std::move(params_desc)),_return_type(return_type){}
+            //异步服务：回调返回时不必产出结果，之后在任意线程上通过 Responder 应答
+            using AsyncServiceCallback=std::function<void(const Json::Value& ,const std::shared_ptr<Responder>& )>;
+            ServiceDescribe(std::string&& method_name,ServiceCallback&& cb, std::vector<ParamsDescribe>&& params_desc,ValType return_type,
+                            ExecMode exec_mode=ExecMode::DEFAULT)
+            :_method_name(std::move(method_name)),_service_cb(std::move(cb)),_params_desc(std::move(params_desc)),_return_type(return_type),_exec_mode(exec_mode){}
+            ServiceDescribe(std::string&& method_name,AsyncServiceCallback&& cb, std::vector<ParamsDescribe>&& params_desc,ValType return_type,
+                            ExecMode exec_mode=ExecMode::DEFAULT)
+            :_method_name(std::move(method_name)),_async_cb(std::move(cb)),_params_desc(std::move(params_desc)),_return_type(return_type),_exec_mode(exec_mode){}
             
             bool checkParams(const Json::Value& params)
             {
@@ -59,7 +75,15 @@ namespace lcz_rpc{
                 }
                 return true;
             }
+            bool isAsync()const {return static_cast<bool>(_async_cb);}
+            void callAsync(const Json::Value& param,const std::shared_ptr<Responder>& responder){_async_cb(param,responder);}
+            bool checkResult(const Json::Value& result){return check_return_ty(result);}
             const std::string& getMethodname()const {return _method_name;}
+            ExecMode execMode()const {return _exec_mode.load(std::memory_order_relaxed);}
+            void setExecMode(ExecMode mode){_exec_mode.store(mode,std::memory_order_relaxed);}
+            //方法级准入控制，为空时只受全局设置约束；需在服务启动前设置
+            const AdmissionController::ptr& admission()const {return _admission;}
+            void setAdmission(const AdmissionController::ptr& admission){_admission=admission;}
             private:
             bool check_return_ty(const Json::Value& val)
             {
@@ -82,8 +106,50 @@ namespace lcz_rpc{
             private:    
             std::string _method_name; 
             ServiceCallback _service_cb;
+            AsyncServiceCallback _async_cb;
             std::vector<ParamsDescribe> _params_desc;
             ValType _return_type;
+            std::atomic<ExecMode> _exec_mode;
+            AdmissionController::ptr _admission;
+        };
+        //异步服务的应答对象：一个请求对应一个，可以在任意线程上晚于服务回调完成
+        //只有第一次 complete/fail 生效；结果按声明的返回类型校验；最后一个引用释放时仍未应答则以 INTERNAL_ERROR 应答，请求不会悬空
+        class Responder
+        {
+            public:
+            using ptr=std::shared_ptr<Responder>;
+            Responder(const ServiceDescribe::ptr& service,const LocalEndpoint::Reply& reply):_service(service),_reply(reply){}
+            ~Responder()
+            {
+                if(_done.exchange(true))return;
+                WLOG("异步服务未应答,method:%s",_service->getMethodname().c_str());
+                _reply(RespCode::INTERNAL_ERROR,Json::Value());
+            }
+            //返回 false 表示已经应答过或结果类型不符（此时以 INTERNAL_ERROR 应答）
+            bool complete(const Json::Value& result)
+            {
+                if(_done.exchange(true))return false;
+                if(_service->checkResult(result)==false)
+                {
+                    ELOG("回调 函数中的处理结果校验失败,method:%s",_service->getMethodname().c_str());
+                    _reply(RespCode::INTERNAL_ERROR,Json::Value());
+                    return false;
+                }
+                _reply(RespCode::SUCCESS,result);
+                return true;
+            }
+            bool fail(RespCode rcode)
+            {
+                if(_done.exchange(true))return false;
+                _reply(rcode,Json::Value());
+                return true;
+            }
+            bool done()const {return _done.load();}
+            const std::string& method()const {return _service->getMethodname();}
+            private:
+            ServiceDescribe::ptr _service;
+            LocalEndpoint::Reply _reply;
+            std::atomic<bool> _done{false};
         };
         //建造者模式
         class ServiceFactory
@@ -93,6 +159,11 @@ namespace lcz_rpc{
             void setMethodName(const std::string& method_name){_method_name=method_name;}
             void setParamdescribe(const std::string& param_name,ValType vtype){_params_desc.emplace_back(param_name,vtype);}
             void setServiceCallback(const ServiceDescribe::ServiceCallback& cb){_service_cb=cb;}
+            //与 setServiceCallback 二选一，设置后构建异步服务
+            void setAsyncServiceCallback(const ServiceDescribe::AsyncServiceCallback& cb){_async_cb=cb;}
+            void setExecMode(ExecMode mode){_exec_mode=mode;}
+            //方法级准入控制（在途上限与排队时间目标），与 RpcServer 的全局设置同时生效
+            void setAdmission(const AdmissionPolicy& policy){_admission=std::make_shared<AdmissionController>(policy);}
             
             // ServiceDescribe::ptr build(){return std::make_shared<ServiceDescribe>(std::move(_method_name),std::move(_service_cb),std::move(_params_desc),_return_type);}
             ServiceDescribe::ptr build()
@@ -100,91 +171,277 @@ namespace lcz_rpc{
                 std::string method_name = _method_name;
                 ServiceDescribe::ServiceCallback service_cb = _service_cb;
                 std::vector<ServiceDescribe::ParamsDescribe> params_desc = _params_desc;
-                
-                return std::make_shared<ServiceDescribe>(
-                    std::move(method_name),
-                    std::move(service_cb), 
-                    std::move(params_desc),
-                    _return_type
-                );
+                ServiceDescribe::ptr service;
+                if(_async_cb)
+                {
+                    ServiceDescribe::AsyncServiceCallback async_cb = _async_cb;
+                    service = std::make_shared<ServiceDescribe>(std::move(method_name),std::move(async_cb),std::move(params_desc),_return_type,_exec_mode);
+                }
+                else
+                {
+                    service = std::make_shared<ServiceDescribe>(
+                        std::move(method_name),
+                        std::move(service_cb), 
+                        std::move(params_desc),
+                        _return_type,
+                        _exec_mode
+                    );
+                }
+                service->setAdmission(_admission);
+                return service;
             }
             private:
             std::string _method_name; 
             ServiceDescribe::ServiceCallback _service_cb;
+            ServiceDescribe::AsyncServiceCallback _async_cb;
             std::vector<ServiceDescribe::ParamsDescribe> _params_desc;
             ValType _return_type;
+            ExecMode _exec_mode=ExecMode::DEFAULT;
+            AdmissionController::ptr _admission;
 
         };
         //服务管理类
-        // 简单的线程安全注册表（method -> ServiceDescribe）
+        // 方法表（method -> ServiceDescribe）：注册只在启动时发生，每次请求都要查找
+        // 以不可变快照发布，查找只是一次原子读指针，不加锁、不动引用计数；每个方法注册时分配一个整数 ID，按 ID 查找只是一次数组下标
+        // 旧快照保留到 ServiceManager 析构（只在注册/移除时产生，数量很少），读者因此不需要任何回收协议
         class ServiceManager
         {
             public:
             using ptr=std::shared_ptr<ServiceManager>;
-            void add(const ServiceDescribe::ptr& service){std::unique_lock<std::mutex> lock(_mutex);_services[service->getMethodname()]=service;}
-            
-            ServiceDescribe::ptr select(const std::string& methodname)
+            ServiceManager()
+            {
+                _tables.emplace_back(new MethodTable());
+                _table.store(_tables.back().get(),std::memory_order_release);
+            }
+            //同名方法重复注册时替换服务，ID 保持不变
+            MethodId add(const ServiceDescribe::ptr& service)
             {
                 std::unique_lock<std::mutex> lock(_mutex);
-                auto it=_services.find(methodname);
-                if(it!=_services.end())
+                std::unique_ptr<MethodTable> next(new MethodTable(*_table.load(std::memory_order_relaxed)));
+                auto it=next->ids.find(service->getMethodname());
+                MethodId id;
+                if(it!=next->ids.end())
+                {
+                    id=it->second;
+                    next->services[id]=service;
+                }
+                else
                 {
-                    return it->second;
+                    id=static_cast<MethodId>(next->services.size());
+                    next->ids.emplace(service->getMethodname(),id);
+                    next->services.push_back(service);
                 }
-                return nullptr;
+                publish(std::move(next));
+                return id;
             }
+            //返回的引用指向快照内的元素，在 ServiceManager 析构前一直有效；热路径按引用使用即可省去一次引用计数
+            const ServiceDescribe::ptr& select(const std::string& methodname)
+            {
+                const MethodTable* table=_table.load(std::memory_order_acquire);
+                auto it=table->ids.find(methodname);
+                if(it!=table->ids.end())
+                {
+                    return table->services[it->second];
+                }
+                return none();
+            }
+            const ServiceDescribe::ptr& select(MethodId id)
+            {
+                const MethodTable* table=_table.load(std::memory_order_acquire);
+                return id<table->services.size()?table->services[id]:none();
+            }
+            //方法的 ID，未注册时返回 kInvalidMethodId
+            MethodId methodId(const std::string& methodname)
+            {
+                const MethodTable* table=_table.load(std::memory_order_acquire);
+                auto it=table->ids.find(methodname);
+                return it!=table->ids.end()?it->second:kInvalidMethodId;
+            }
+            //当前已注册的 方法名->ID，供客户端握手
+            Json::Value methodIds()
+            {
+                const MethodTable* table=_table.load(std::memory_order_acquire);
+                Json::Value ids(Json::objectValue);
+                for(const auto& item:table->ids)
+                {
+                    if(table->services[item.second].get()!=nullptr)ids[item.first]=item.second;
+                }
+                return ids;
+            }
+            //移除后 ID 仍然保留给该方法名，之后重新注册时沿用，已经拿到 ID 的调用方查到的是空服务
             bool remove(const std::string& methodname)
             {
                 std::unique_lock<std::mutex> lock(_mutex);
-                auto it=_services.find(methodname);
-                if(it!=_services.end())
+                const MethodTable* cur=_table.load(std::memory_order_relaxed);
+                auto it=cur->ids.find(methodname);
+                if(it==cur->ids.end()||cur->services[it->second].get()==nullptr)
                 {
-                     _services.erase(it);
-                     return true;
+                    return false;
                 }
-                return false;
+                std::unique_ptr<MethodTable> next(new MethodTable(*cur));
+                next->services[it->second]=nullptr;
+                publish(std::move(next));
+                return true;
             }
 
             private:
-            std::mutex _mutex;
-            std::unordered_map<std::string,ServiceDescribe::ptr> _services;
+            struct MethodTable
+            {
+                std::unordered_map<std::string,MethodId> ids;
+                std::vector<ServiceDescribe::ptr> services;//下标即方法 ID
+            };
+            static const ServiceDescribe::ptr& none()
+            {
+                static const ServiceDescribe::ptr empty;
+                return empty;
+            }
+            //调用方持有 _mutex
+            void publish(std::unique_ptr<MethodTable> next)
+            {
+                _table.store(next.get(),std::memory_order_release);
+                _tables.push_back(std::move(next));
+            }
+            std::mutex _mutex;//串行化注册/移除
+            std::vector<std::unique_ptr<const MethodTable>> _tables;//全部版本，最后一个为当前表
+            std::atomic<const MethodTable*> _table;
         };
         //
         // 核心路由器：将 RPC 请求派发到对应的 ServiceDescribe
-        class RpcRouter
+        // 同时作为进程内端点：同进程的 RpcClient 直接调用 invoke，跳过序列化和网络
+        class RpcRouter : public LocalEndpoint
         {
             public:
             using ptr=std::shared_ptr<RpcRouter>;
             RpcRouter() : _manager(std::make_shared<ServiceManager>()) {}
             //注册到dispacher模块对rpc请求进行回调处理的业务函数
+            //池化执行的方法投递到工作线程，I/O 线程只做查找；响应在工作线程上序列化，由 muduo 送回连接所属的事件循环写出
+            //帧头带方法 ID 的请求直接按下标取服务，不解析、不哈希方法名；不带 ID 的旧格式请求仍按方法名查找
             void onrpcRequst(const BaseConnection::ptr& conn,RpcRequest::ptr& req)
             {
-                DLOG("RpcRouter recv method=%s", req->method().c_str());
-                auto service=_manager->select(req->method());
+                MethodId id=req->methodId();
+                if(id==kInvalidMethodId)
+                {
+                    DLOG("RpcRouter recv method=%s", req->method().c_str());
+                    if(req->method()==METHOD_PING)//内置空操作，客户端预热探测
+                    {
+                        return response(conn,req,Json::Value(),RespCode::SUCCESS);
+                    }
+                    if(req->method()==METHOD_LIST)//握手：下发方法 ID 表
+                    {
+                        return response(conn,req,_manager->methodIds(),RespCode::SUCCESS);
+                    }
+                }
+                const auto& service=id!=kInvalidMethodId?_manager->select(id):_manager->select(req->method());
                 if(service.get()==nullptr)
                 {
-                    ELOG("服务不存在,method:%s",req->method().c_str());
+                    ELOG("服务不存在,method:%s id:%u",req->method().c_str(),id);
                     return response(conn,req,Json::Value(),RespCode::SERVICE_NOT_FOUND);
                 }
-                if(service->checkParams(req->params())==false)
+                //准入在解码参数之前：帧头带方法 ID 的请求被拒绝时消息体从未解析
+                Executor::ptr executor=executorFor(service);
+                AdmissionTicket::ptr ticket;
+                if(_admission||service->admission())
                 {
-                     ELOG("参数校验失败,method:%s",req->method().c_str());
-                    return response(conn,req,Json::Value(),RespCode::INVALID_PARAMS);
+                    ticket=AdmissionTicket::acquire(_admission,service->admission(),executor.get()!=nullptr);
+                    if(ticket.get()==nullptr)
+                    {
+                        return response(conn,req,Json::Value(),RespCode::OVERLOADED);
+                    }
                 }
-                Json::Value result;
-                bool ret=service->call(req->params(),result);
-                if(ret==false)
+                if(executor.get()==nullptr)
+                {
+                    return execute(conn,req,service,ticket);
+                }
+                //任务只持有请求本身、服务描述和准入名额，不引用路由器，线程池排空时路由器可能已经析构
+                RpcRequest::ptr request=req;
+                if(ticket)ticket->enqueue();
+                executor->post([conn,request,service,ticket](){
+                    if(ticket)ticket->dequeue();
+                    execute(conn,request,service,ticket);
+                });
+            }
+            //进程内调用：与网络请求相同的处理流程，结果直接交给 reply
+            void invoke(const std::string& method,const Json::Value& params,const Reply& reply) override
+            {
+                if(method==METHOD_PING)
+                {
+                    return reply(RespCode::SUCCESS,Json::Value());
+                }
+                if(method==METHOD_LIST)
+                {
+                    return reply(RespCode::SUCCESS,_manager->methodIds());
+                }
+                const auto& service=_manager->select(method);
+                if(service.get()==nullptr)
+                {
+                    ELOG("服务不存在,method:%s",method.c_str());
+                    return reply(RespCode::SERVICE_NOT_FOUND,Json::Value());
+                }
+                //与网络请求一样遵守执行位置：池化的方法投递到工作线程池，不占用调用方线程（可能是调用方的 I/O 线程）
+                Executor::ptr executor=executorFor(service);
+                AdmissionTicket::ptr ticket;
+                if(_admission||service->admission())
+                {
+                    ticket=AdmissionTicket::acquire(_admission,service->admission(),executor.get()!=nullptr);
+                    if(ticket.get()==nullptr)
+                    {
+                        return reply(RespCode::OVERLOADED,Json::Value());
+                    }
+                }
+                if(executor.get()==nullptr)
                 {
-                    ELOG("这里应该是服务调用失败,method:%s",req->method().c_str());
-                    return response(conn,req,Json::Value(),RespCode::INTERNAL_ERROR);
+                    return executeLocal(service,params,reply,ticket);
                 }
-                DLOG("RpcRouter respond method=%s", req->method().c_str());
-                return response(conn,req,result,RespCode::SUCCESS);
+                if(ticket)ticket->enqueue();
+                executor->post([service,params,reply,ticket](){
+                    if(ticket)ticket->dequeue();
+                    executeLocal(service,params,reply,ticket);
+                });
+            }
+            //全局准入控制：所有方法共享的在途上限与排队时间目标，需在服务启动前设置
+            void setAdmission(const AdmissionPolicy& policy){_admission=std::make_shared<AdmissionController>(policy);}
+            //方法级准入控制，方法尚未注册时返回 false；需在服务启动前设置
+            bool setAdmission(const std::string& method,const AdmissionPolicy& policy)
+            {
+                const auto& service=_manager->select(method);
+                if(service.get()==nullptr)return false;
+                service->setAdmission(std::make_shared<AdmissionController>(policy));
+                return true;
+            }
+            //全局准入统计，未开启时全部为 0
+            AdmissionController::Stats admissionStats(){return _admission?_admission->stats():AdmissionController::Stats();}
+            //方法级准入统计，方法未注册或未单独设置时全部为 0
+            AdmissionController::Stats admissionStats(const std::string& method)
+            {
+                const auto& service=_manager->select(method);
+                if(service.get()==nullptr||!service->admission())return AdmissionController::Stats();
+                return service->admission()->stats();
             }
             //提供给用户注册服务
             void registerMethod(const ServiceDescribe::ptr& service){_manager->add(service);}
-            void response(const BaseConnection::ptr& conn,const RpcRequest::ptr& req,const Json::Value& result,RespCode rcode)
+            MethodId methodId(const std::string& method){return _manager->methodId(method);}
+            //工作线程池与未单独设置执行位置的方法的默认位置，需在服务启动前设置
+            void setExecutor(const Executor::ptr& executor,ExecMode default_mode)
+            {
+                _executor=executor;
+                _default_mode=default_mode==ExecMode::DEFAULT?ExecMode::POOLED:default_mode;
+            }
+            //单独设置方法的执行位置，方法尚未注册时返回 false
+            bool setExecMode(const std::string& method,ExecMode mode)
+            {
+                auto service=_manager->select(method);
+                if(service.get()==nullptr)return false;
+                service->setExecMode(mode);
+                return true;
+            }
+            //异步服务可能在连接断开之后才应答，此时直接丢弃
+            static void response(const BaseConnection::ptr& conn,const RpcRequest::ptr& req,const Json::Value& result,RespCode rcode)
             {
+                if(conn->connected()==false)
+                {
+                    DLOG("连接已断开，丢弃响应,rid:%s",req->rid().c_str());
+                    return;
+                }
                 auto resp=MessageFactory::create<RpcResponse>();
                 resp->setId(req->rid());
                 resp->setMsgType(lcz_rpc::MsgType::RSP_RPC);
@@ -193,7 +450,85 @@ namespace lcz_rpc{
                 conn->send(resp);
             }
             private:
+            //方法应投递到的线程池，就地执行时返回空
+            Executor::ptr executorFor(const ServiceDescribe::ptr& service)
+            {
+                if(_executor.get()==nullptr)return Executor::ptr();
+                ExecMode mode=service->execMode();
+                if(mode==ExecMode::DEFAULT)mode=_default_mode;
+                return mode==ExecMode::POOLED?_executor:Executor::ptr();
+            }
+            //ticket 为空表示未开启准入控制；应答后立即归还名额
+            static void execute(const BaseConnection::ptr& conn,const RpcRequest::ptr& req,const ServiceDescribe::ptr& service,
+                                const AdmissionTicket::ptr& ticket)
+            {
+                if(req->decode()==false)//帧头带方法 ID 的请求在这里才解码消息体，池化执行时由工作线程完成
+                {
+                    ELOG("消息体解码失败,method:%s",service->getMethodname().c_str());
+                    response(conn,req,Json::Value(),RespCode::PARSE_FAILED);
+                    if(ticket)ticket->release();
+                    return;
+                }
+                if(service->isAsync())
+                {
+                    return executeAsync(service,req->params(),[conn,req,ticket](RespCode rcode,const Json::Value& result){
+                        response(conn,req,result,rcode);
+                        if(ticket)ticket->release();
+                    });
+                }
+                Json::Value result;
+                RespCode rcode=run(service,req->params(),result);
+                DLOG("RpcRouter respond method=%s", service->getMethodname().c_str());
+                response(conn,req,result,rcode);
+                if(ticket)ticket->release();
+            }
+            //进程内调用的执行：结果直接交给 reply，应答后归还准入名额
+            static void executeLocal(const ServiceDescribe::ptr& service,const Json::Value& params,const Reply& reply,
+                                     const AdmissionTicket::ptr& ticket)
+            {
+                if(service->isAsync())
+                {
+                    return executeAsync(service,params,[reply,ticket](RespCode rcode,const Json::Value& result){
+                        if(ticket)ticket->release();
+                        reply(rcode,result);
+                    });
+                }
+                Json::Value result;
+                RespCode rcode=run(service,params,result);
+                if(ticket)ticket->release();
+                reply(rcode,result);
+            }
+            //异步服务：参数校验失败立即应答，否则交给服务回调，由 Responder 在之后应答
+            static void executeAsync(const ServiceDescribe::ptr& service,const Json::Value& params,const Reply& reply)
+            {
+                if(service->checkParams(params)==false)
+                {
+                    ELOG("参数校验失败,method:%s",service->getMethodname().c_str());
+                    return reply(RespCode::INVALID_PARAMS,Json::Value());
+                }
+                service->callAsync(params,std::make_shared<Responder>(service,reply));
+            }
+            //校验参数、执行并校验返回值；失败时 result 保持为空
+            static RespCode run(const ServiceDescribe::ptr& service,const Json::Value& params,Json::Value& result)
+            {
+                const std::string& method=service->getMethodname();
+                if(service->checkParams(params)==false)
+                {
+                    ELOG("参数校验失败,method:%s",method.c_str());
+                    return RespCode::INVALID_PARAMS;
+                }
+                if(service->call(params,result)==false)
+                {
+                    ELOG("这里应该是服务调用失败,method:%s",method.c_str());
+                    result=Json::Value();
+                    return RespCode::INTERNAL_ERROR;
+                }
+                return RespCode::SUCCESS;
+            }
             ServiceManager::ptr _manager;
+            Executor::ptr _executor;//工作线程池，为空时全部在 I/O 线程上执行
+            ExecMode _default_mode=ExecMode::POOLED;
+            AdmissionController::ptr _admission;//全局准入控制，为空时不限制
         };
     }
 }
\ No newline at end of file
@@ -87,13 +87,16 @@ namespace lcz_rpc
                  _server->setMessageCallback(msg_cb);
  
                 // RpcServer 仅维持 Provider 心跳与负载上报
+                //登记为进程内端点，同进程的 RpcClient 调用本服务时直接执行，不走网络
+                LocalRegistry::instance().add(_access_addr, _rpc_router);
             }
+            ~RpcServer() { LocalRegistry::instance().remove(_access_addr, _rpc_router); }
             void registerMethod(const ServiceDescribe::ptr &service)
             {
                 if (_enablediscover)  // 如果启用服务发现，向注册中心注册方法
                 {
                     int currentLoad = 10; // 临时写死，后续再做动态更新
-                    if(_client_registry->methodRegistry(service->getMethodname(), _access_addr, currentLoad))
+                    if(_client_registry->methodRegistry(service->getMethodname(), _access_addr, currentLoad, _weight, _locality))
                     {
                         {
                             std::unique_lock<std::mutex>lock(_methods_mutex);
@@ -117,6 +120,37 @@ namespace lcz_rpc
                 _rpc_router->registerMethod(service);
 
             }
+            //注册到注册中心的静态容量权重，需在 registerMethod 之前设置；默认取 CPU 核数
+            void setWeight(int weight) { _weight = std::max(weight, 1); }
+            //注册到注册中心的位置标签（可用区/机架/物理机），需在 registerMethod 之前设置
+            void setLocality(const Locality &locality) { _locality = locality; }
+            //服务执行线程池：池化执行的方法不再占用 I/O 线程，计算密集的方法不会拖慢同一事件循环上的其他连接
+            //default_mode 决定未单独设置的方法的执行位置，需在 start 之前设置
+            void setWorkerPool(const Executor::ptr &executor, ExecMode default_mode = ExecMode::POOLED)
+            {
+                _workers = std::dynamic_pointer_cast<WorkStealingExecutor>(executor);
+                _rpc_router->setExecutor(executor, default_mode);
+            }
+            //按线程数创建工作窃取线程池：I/O 线程投递到亲和的工作线程，空闲的工作线程从其他队列窃取
+            void setWorkerPool(size_t threads, ExecMode default_mode = ExecMode::POOLED)
+            {
+                setWorkerPool(std::make_shared<WorkStealingExecutor>(threads), default_mode);
+            }
+            //工作窃取线程池的队列深度、窃取次数与排队等待时间，未使用工作窃取线程池时全部为 0
+            WorkStealingExecutor::Stats workerStats() const
+            {
+                return _workers ? _workers->stats() : WorkStealingExecutor::Stats();
+            }
+            //单独设置已注册方法的执行位置（也可以在构建时用 ServiceFactory::setExecMode 指定）
+            bool setExecMode(const std::string &method, ExecMode mode) { return _rpc_router->setExecMode(method, mode); }
+            //准入控制：在途请求达到上限时新请求直接以 OVERLOADED 拒绝；工作线程池的排队时间在一个观察窗口内始终高于目标（CoDel）时，按 interval/sqrt(count) 的间隔逐个拒绝新的池化请求，排队清空即停止
+            //排队时间只对投递到工作线程池（ExecMode::POOLED）的请求测量，未设置工作线程池时 CoDel 规则不会触发，只有在途上限生效
+            //拒绝发生在解码参数之前；全局设置约束全部方法，方法级设置（也可用 ServiceFactory::setAdmission）同时生效；需在 start 之前设置
+            void setAdmission(const AdmissionPolicy &policy) { _rpc_router->setAdmission(policy); }
+            bool setAdmission(const std::string &method, const AdmissionPolicy &policy) { return _rpc_router->setAdmission(method, policy); }
+            //准入统计：在途数、排队数、准入/拒绝次数与是否处于拒绝状态
+            AdmissionController::Stats admissionStats() { return _rpc_router->admissionStats(); }
+            AdmissionController::Stats admissionStats(const std::string &method) { return _rpc_router->admissionStats(method); }
             void start() { _server->start(); }
         private:
             int currentLoad()const
@@ -163,9 +197,12 @@ namespace lcz_rpc
         private:
             HostInfo _access_addr;// 本机RPC服务访问地址
             bool _enablediscover;//是否启用服务发现
+            int _weight = std::max<int>(static_cast<int>(std::thread::hardware_concurrency()), 1);//容量权重
+            Locality _locality;//位置标签
             client::ClientRegistry::ptr _client_registry;//注册中心客户端
             Dispacher::ptr _dispacher;//消息分发器
             RpcRouter::ptr _rpc_router;//RPC路由器
+            WorkStealingExecutor::ptr _workers;//服务执行线程池，用于读取统计
             BaseServer::ptr _server;//网络服务器
 
             HeartbeatConfig _hb_config; // 心跳配置